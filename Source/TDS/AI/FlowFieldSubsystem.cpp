@@ -0,0 +1,557 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FlowFieldSubsystem.h"
+#include "Engine/World.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "NavigationSystem.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+#include "DrawDebugHelpers.h"
+
+#include "../TDSStats.h"
+
+static TAutoConsoleVariable<int32> CVarFlowFieldParallelMinCount(
+	TEXT("tds.FlowField.ParallelMinCount"),
+	64,
+	TEXT("Flow field agents are steered with ParallelFor when there are at least this many (0 = always single thread)."));
+
+static TAutoConsoleVariable<int32> CVarFlowFieldDebug(
+	TEXT("tds.FlowField.Debug"),
+	0,
+	TEXT("Draws the flow field this many cells around the first player (0 = off)."));
+
+// Half height of the navmesh projection of a cell
+static const float costQueryHalfHeight = 200.f;
+
+static const uint8 GOAL_DIRECTION = 254;
+static const uint8 NO_DIRECTION = 255;
+
+static const FIntPoint neighbourOffsets[8] =
+{
+	FIntPoint(1, 0), FIntPoint(0, 1), FIntPoint(-1, 0), FIntPoint(0, -1),
+	FIntPoint(1, 1), FIntPoint(-1, 1), FIntPoint(-1, -1), FIntPoint(1, -1)
+};
+
+static const FVector neighbourDirections[8] =
+{
+	FVector(1.f, 0.f, 0.f), FVector(0.f, 1.f, 0.f), FVector(-1.f, 0.f, 0.f), FVector(0.f, -1.f, 0.f),
+	FVector(0.70710678f, 0.70710678f, 0.f), FVector(-0.70710678f, 0.70710678f, 0.f),
+	FVector(-0.70710678f, -0.70710678f, 0.f), FVector(0.70710678f, -0.70710678f, 0.f)
+};
+
+void UFlowFieldSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	gridSize = FMath::Max(gridSize, 8);
+	cellSize = FMath::Max(cellSize, 1.f);
+	recenterMargin = FMath::Clamp(recenterMargin, 0, gridSize / 2 - 1);
+
+	const int32 numCells = gridSize * gridSize;
+	cellCosts.SetNumZeroed(numCells);
+	shiftedCosts.SetNumZeroed(numCells);
+	pendingCostCells.Reserve(numCells);
+	integration.SetNumUninitialized(numCells);
+	buildDirections.SetNumUninitialized(numCells);
+	flowDirections.Init(NO_DIRECTION, numCells);
+	cellAgentStart.SetNumZeroed(numCells + 1);
+	openCells.Reserve(numCells);
+}
+
+void UFlowFieldSubsystem::Deinitialize()
+{
+	cellCosts.Empty();
+	shiftedCosts.Empty();
+	pendingCostCells.Empty();
+	integration.Empty();
+	openCells.Empty();
+	buildDirections.Empty();
+	flowDirections.Empty();
+	goalLocations.Empty();
+	goalCells.Empty();
+	builtGoalCells.Empty();
+	fieldGoalLocations.Empty();
+	agents.Empty();
+	agentLocations.Empty();
+	agentDirections.Empty();
+	agentCells.Empty();
+	sortedAgents.Empty();
+	cellAgentStart.Empty();
+
+	Super::Deinitialize();
+}
+
+TStatId UFlowFieldSubsystem::GetStatId() const
+{ RETURN_QUICK_DECLARE_CYCLE_STAT(UFlowFieldSubsystem, STATGROUP_Tickables); }
+
+void UFlowFieldSubsystem::Tick(float DeltaTime)
+{
+	// Enemies are moved by the server
+	if (GetWorld()->GetNetMode() == NM_Client)
+		return;
+
+	{
+		TDS_SCOPE_CYCLE_COUNTER(FlowFieldBuild);
+
+		if (buildPhase == EFlowFieldBuildPhase::IDLE && GatherGoals())
+			StartBuild();
+		if (buildPhase == EFlowFieldBuildPhase::COSTS)
+			BuildCosts();
+		if (buildPhase == EFlowFieldBuildPhase::INTEGRATION)
+			BuildIntegration();
+	}
+
+	TDS_SET_COUNTER(FlowFieldAgents, agents.Num());
+
+	if (bIsFieldReady && agents.Num() > 0)
+		SteerAgents();
+
+#if ENABLE_DRAW_DEBUG
+	const int32 debugCells = CVarFlowFieldDebug.GetValueOnGameThread();
+	if (debugCells > 0 && bIsFieldReady && fieldGoalLocations.Num() > 0)
+	{
+		const int32 centerCell = GetCellIndex(fieldOrigin, fieldGoalLocations[0]);
+		if (centerCell == INDEX_NONE)
+			return;
+
+		const int32 centerX = centerCell % gridSize;
+		const int32 centerY = centerCell / gridSize;
+		const float z = fieldGoalLocations[0].Z;
+
+		for (int32 y = FMath::Max(centerY - debugCells, 0); y <= FMath::Min(centerY + debugCells, gridSize - 1); ++y)
+		{
+			for (int32 x = FMath::Max(centerX - debugCells, 0); x <= FMath::Min(centerX + debugCells, gridSize - 1); ++x)
+			{
+				const uint8 flow = flowDirections[y * gridSize + x];
+				if (flow >= 8)
+					continue;
+
+				const FVector cellCenter(fieldOrigin.X + (x + 0.5f) * cellSize, fieldOrigin.Y + (y + 0.5f) * cellSize, z);
+				DrawDebugDirectionalArrow(GetWorld(), cellCenter, cellCenter + neighbourDirections[flow] * cellSize * 0.4f, cellSize * 0.2f, FColor::Cyan);
+			}
+		}
+	}
+#endif
+}
+
+void UFlowFieldSubsystem::RegisterAgent(APawn* agent)
+{
+	if (agent)
+		agents.AddUnique(agent);
+}
+
+void UFlowFieldSubsystem::UnregisterAgent(APawn* agent)
+{ agents.RemoveSwap(agent); }
+
+FVector UFlowFieldSubsystem::GetFlowDirection(const FVector& location) const
+{
+	if (!bIsFieldReady)
+		return FVector::ZeroVector;
+
+	const int32 cell = GetCellIndex(fieldOrigin, location);
+	if (cell == INDEX_NONE || flowDirections[cell] >= 8)
+		return FVector::ZeroVector;
+
+	return neighbourDirections[flowDirections[cell]];
+}
+
+bool UFlowFieldSubsystem::IsFieldReady() const
+{ return bIsFieldReady; }
+
+int32 UFlowFieldSubsystem::GetNumAgents() const
+{ return agents.Num(); }
+
+// ================================ Build ================================
+
+bool UFlowFieldSubsystem::GatherGoals()
+{
+	goalLocations.Reset();
+	for (FConstPlayerControllerIterator it = GetWorld()->GetPlayerControllerIterator(); it; ++it)
+	{
+		const APlayerController* myController = it->Get();
+		const APawn* myPawn = myController ? myController->GetPawn() : nullptr;
+		if (myPawn)
+			goalLocations.Add(myPawn->GetActorLocation());
+	}
+
+	if (goalLocations.Num() == 0)
+		return false;
+
+	FBox goalBounds(ForceInit);
+	for (const FVector& goal : goalLocations)
+		goalBounds += goal;
+
+	// One cell less, the origin is snapped to whole cells
+	const FVector goalCenter = goalBounds.GetCenter();
+	const float innerHalfExtent = (gridSize * 0.5f - recenterMargin - 1) * cellSize;
+	const bool bIsGoalsFit = goalBounds.GetExtent().X <= innerHalfExtent && goalBounds.GetExtent().Y <= innerHalfExtent;
+
+	// Players that can't all fit would move the grid back and forth between them every frame, their center is followed instead
+	bool bIsRecenter = !bIsCostsValid;
+	if (bIsGoalsFit)
+	{
+		for (const FVector& goal : goalLocations)
+			bIsRecenter |= !IsInsideInnerArea(goal);
+	}
+	else
+		bIsRecenter |= !IsInsideInnerArea(goalCenter);
+
+	if (bIsRecenter)
+		RecenterGrid(goalCenter);
+
+	goalCells.Reset();
+	for (const FVector& goal : goalLocations)
+	{
+		const int32 cell = GetCellIndex(buildOrigin, goal);
+		if (cell != INDEX_NONE)
+			goalCells.AddUnique(cell);
+	}
+
+	return bIsRecenter || goalCells != builtGoalCells;
+}
+
+void UFlowFieldSubsystem::RecenterGrid(const FVector& center)
+{
+	const int32 numCells = gridSize * gridSize;
+	const float halfExtent = gridSize * cellSize * 0.5f;
+	const FVector2D newOrigin(FMath::GridSnap(center.X - halfExtent, cellSize), FMath::GridSnap(center.Y - halfExtent, cellSize));
+	const int32 shiftX = FMath::RoundToInt((newOrigin.X - buildOrigin.X) / cellSize);
+	const int32 shiftY = FMath::RoundToInt((newOrigin.Y - buildOrigin.Y) / cellSize);
+
+	pendingCostCells.Reset();
+
+	// Costs are projected at buildZ, on another floor all of them are found again
+	const bool bIsKeepCosts = bIsCostsValid && FMath::Abs(center.Z - buildZ) < costQueryHalfHeight * 0.5f
+		&& FMath::Abs(shiftX) < gridSize && FMath::Abs(shiftY) < gridSize;
+
+	if (bIsKeepCosts)
+	{
+		for (int32 y = 0; y < gridSize; ++y)
+		{
+			for (int32 x = 0; x < gridSize; ++x)
+			{
+				const int32 cell = y * gridSize + x;
+				const int32 oldX = x + shiftX;
+				const int32 oldY = y + shiftY;
+
+				if (oldX >= 0 && oldY >= 0 && oldX < gridSize && oldY < gridSize)
+					shiftedCosts[cell] = cellCosts[oldY * gridSize + oldX];
+				else
+					pendingCostCells.Add(cell);
+			}
+		}
+
+		Swap(cellCosts, shiftedCosts);
+	}
+	else
+	{
+		buildZ = center.Z;
+		for (int32 cell = 0; cell < numCells; ++cell)
+			pendingCostCells.Add(cell);
+	}
+
+	buildOrigin = newOrigin;
+	bIsCostsValid = pendingCostCells.Num() == 0;
+}
+
+void UFlowFieldSubsystem::StartBuild()
+{
+	if (bIsCostsValid)
+	{
+		StartIntegration();
+		return;
+	}
+
+	costCursor = 0;
+	buildPhase = EFlowFieldBuildPhase::COSTS;
+}
+
+void UFlowFieldSubsystem::StartIntegration()
+{
+	for (int32& distance : integration)
+		distance = MAX_int32;
+
+	openCells.Reset();
+	openHead = 0;
+
+	// Every player is a source, agents go to the nearest one
+	for (const int32 cell : goalCells)
+	{
+		integration[cell] = 0;
+		openCells.Add(cell);
+	}
+
+	buildPhase = EFlowFieldBuildPhase::INTEGRATION;
+}
+
+void UFlowFieldSubsystem::BuildCosts()
+{
+	const UNavigationSystemV1* navSys = bUseNavMesh ? FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld()) : nullptr;
+	// A level without a navmesh would block everything
+	if (navSys && !navSys->GetDefaultNavDataInstance())
+		navSys = nullptr;
+
+	const FVector queryExtent(cellSize * 0.5f, cellSize * 0.5f, costQueryHalfHeight);
+	const int32 lastCursor = FMath::Min(costCursor + FMath::Max(costCellsPerFrame, 1), pendingCostCells.Num());
+
+	for (; costCursor < lastCursor; ++costCursor)
+	{
+		const int32 cell = pendingCostCells[costCursor];
+		if (!navSys)
+		{
+			cellCosts[cell] = 1;
+			continue;
+		}
+
+		const FVector cellCenter(buildOrigin.X + (cell % gridSize + 0.5f) * cellSize, buildOrigin.Y + (cell / gridSize + 0.5f) * cellSize, buildZ);
+		FNavLocation navLocation;
+		cellCosts[cell] = navSys->ProjectPointToNavigation(cellCenter, navLocation, queryExtent) ? 1 : 0;
+	}
+
+	if (costCursor < pendingCostCells.Num())
+		return;
+
+	pendingCostCells.Reset();
+
+	bIsCostsValid = true;
+	StartIntegration();
+}
+
+void UFlowFieldSubsystem::BuildIntegration()
+{
+	int32 budget = FMath::Max(integrationCellsPerFrame, 1);
+
+	// Breadth first over the 4 neighbours, every step costs the same
+	while (openHead < openCells.Num() && budget-- > 0)
+	{
+		const int32 cell = openCells[openHead++];
+		const int32 x = cell % gridSize;
+		const int32 y = cell / gridSize;
+		const int32 nextDistance = integration[cell] + 1;
+
+		for (int32 i = 0; i < 4; ++i)
+		{
+			const int32 nextX = x + neighbourOffsets[i].X;
+			const int32 nextY = y + neighbourOffsets[i].Y;
+			if (nextX < 0 || nextY < 0 || nextX >= gridSize || nextY >= gridSize)
+				continue;
+
+			const int32 nextCell = nextY * gridSize + nextX;
+			if (cellCosts[nextCell] == 0 || integration[nextCell] != MAX_int32)
+				continue;
+
+			integration[nextCell] = nextDistance;
+			openCells.Add(nextCell);
+		}
+	}
+
+	if (openHead < openCells.Num())
+		return;
+
+	BuildDirections();
+
+	// Agents switch to the new field at once
+	Swap(flowDirections, buildDirections);
+	fieldOrigin = buildOrigin;
+	fieldGoalLocations = goalLocations;
+	builtGoalCells = goalCells;
+	bIsFieldReady = true;
+	buildPhase = EFlowFieldBuildPhase::IDLE;
+}
+
+void UFlowFieldSubsystem::BuildDirections()
+{
+	ParallelFor(gridSize, [this](int32 y)
+	{
+		for (int32 x = 0; x < gridSize; ++x)
+		{
+			const int32 cell = y * gridSize + x;
+			const int32 distance = integration[cell];
+
+			if (distance == MAX_int32)
+			{
+				buildDirections[cell] = NO_DIRECTION;
+				continue;
+			}
+			if (distance == 0)
+			{
+				buildDirections[cell] = GOAL_DIRECTION;
+				continue;
+			}
+
+			uint8 bestDirection = NO_DIRECTION;
+			int32 bestDistance = distance;
+
+			for (int32 i = 0; i < 8; ++i)
+			{
+				const int32 nextX = x + neighbourOffsets[i].X;
+				const int32 nextY = y + neighbourOffsets[i].Y;
+				if (nextX < 0 || nextY < 0 || nextX >= gridSize || nextY >= gridSize)
+					continue;
+
+				// Diagonal only past two walkable cells, so agents don't cut the corners of walls
+				if (i >= 4 && (cellCosts[y * gridSize + nextX] == 0 || cellCosts[nextY * gridSize + x] == 0))
+					continue;
+
+				const int32 nextDistance = integration[nextY * gridSize + nextX];
+				if (nextDistance < bestDistance)
+				{
+					bestDistance = nextDistance;
+					bestDirection = i;
+				}
+			}
+
+			buildDirections[cell] = bestDirection;
+		}
+	});
+}
+
+// ================================ Agents ================================
+
+void UFlowFieldSubsystem::SteerAgents()
+{
+	TDS_SCOPE_CYCLE_COUNTER(FlowFieldSteering);
+
+	// Actors are read and moved on the game thread only
+	for (int32 i = agents.Num() - 1; i >= 0; --i)
+	{
+		if (!agents[i].IsValid())
+			agents.RemoveAtSwap(i);
+	}
+
+	const int32 numAgents = agents.Num();
+	agentLocations.SetNumUninitialized(numAgents);
+	agentDirections.SetNumUninitialized(numAgents);
+	agentCells.SetNumUninitialized(numAgents);
+
+	for (int32 i = 0; i < numAgents; ++i)
+	{
+		agentLocations[i] = agents[i]->GetActorLocation();
+		agentCells[i] = GetCellIndex(fieldOrigin, agentLocations[i]);
+	}
+
+	SortAgentsByCell();
+
+	const int32 parallelMinCount = CVarFlowFieldParallelMinCount.GetValueOnGameThread();
+	const bool bForceSingleThread = parallelMinCount <= 0 || numAgents < parallelMinCount;
+
+	ParallelFor(numAgents, [this](int32 i)
+	{
+		const int32 cell = agentCells[i];
+		if (cell == INDEX_NONE)
+		{
+			agentDirections[i] = FVector::ZeroVector;
+			return;
+		}
+
+		const FVector& location = agentLocations[i];
+		FVector direction = FVector::ZeroVector;
+		const uint8 flow = flowDirections[cell];
+
+		if (flow < 8)
+		{
+			direction = neighbourDirections[flow];
+		}
+		else if (flow == GOAL_DIRECTION)
+		{
+			float bestDistanceSq = MAX_flt;
+			for (const FVector& goal : fieldGoalLocations)
+			{
+				const float distanceSq = FVector::DistSquared2D(goal, location);
+				if (distanceSq < bestDistanceSq)
+				{
+					bestDistanceSq = distanceSq;
+					direction = (goal - location).GetSafeNormal2D();
+				}
+			}
+		}
+
+		// Neighbours from the 3x3 cells around, enough while the radius is not larger than a cell
+		if (separationRadius > 0.f && separationWeight > 0.f)
+		{
+			const int32 x = cell % gridSize;
+			const int32 y = cell / gridSize;
+			FVector separation = FVector::ZeroVector;
+
+			for (int32 nextY = FMath::Max(y - 1, 0); nextY <= FMath::Min(y + 1, gridSize - 1); ++nextY)
+			{
+				for (int32 nextX = FMath::Max(x - 1, 0); nextX <= FMath::Min(x + 1, gridSize - 1); ++nextX)
+				{
+					const int32 nextCell = nextY * gridSize + nextX;
+					for (int32 k = cellAgentStart[nextCell]; k < cellAgentStart[nextCell + 1]; ++k)
+					{
+						const int32 other = sortedAgents[k];
+						if (other == i)
+							continue;
+
+						FVector offset = location - agentLocations[other];
+						offset.Z = 0.f;
+						const float distance = offset.Size();
+						if (distance < separationRadius && distance > KINDA_SMALL_NUMBER)
+							separation += offset / distance * (1.f - distance / separationRadius);
+					}
+				}
+			}
+
+			direction += separation * separationWeight;
+		}
+
+		agentDirections[i] = direction.GetClampedToMaxSize(1.f);
+	}, bForceSingleThread);
+
+	for (int32 i = 0; i < numAgents; ++i)
+	{
+		if (!agentDirections[i].IsNearlyZero())
+			agents[i]->AddMovementInput(agentDirections[i]);
+	}
+}
+
+void UFlowFieldSubsystem::SortAgentsByCell()
+{
+	// Counting sort: agents of a cell end up next to each other
+	const int32 numCells = gridSize * gridSize;
+	FMemory::Memzero(cellAgentStart.GetData(), cellAgentStart.Num() * sizeof(int32));
+
+	for (const int32 cell : agentCells)
+	{
+		if (cell != INDEX_NONE)
+			++cellAgentStart[cell + 1];
+	}
+
+	for (int32 cell = 0; cell < numCells; ++cell)
+		cellAgentStart[cell + 1] += cellAgentStart[cell];
+
+	sortedAgents.SetNumUninitialized(cellAgentStart[numCells]);
+
+	// Start of every cell is used as its write cursor and ends up at the start of the next cell
+	for (int32 i = 0; i < agentCells.Num(); ++i)
+	{
+		if (agentCells[i] != INDEX_NONE)
+			sortedAgents[cellAgentStart[agentCells[i]]++] = i;
+	}
+
+	for (int32 cell = numCells; cell > 0; --cell)
+		cellAgentStart[cell] = cellAgentStart[cell - 1];
+	cellAgentStart[0] = 0;
+}
+
+int32 UFlowFieldSubsystem::GetCellIndex(const FVector2D& origin, const FVector& location) const
+{
+	const int32 x = FMath::FloorToInt((location.X - origin.X) / cellSize);
+	const int32 y = FMath::FloorToInt((location.Y - origin.Y) / cellSize);
+
+	if (x < 0 || y < 0 || x >= gridSize || y >= gridSize)
+		return INDEX_NONE;
+
+	return y * gridSize + x;
+}
+
+bool UFlowFieldSubsystem::IsInsideInnerArea(const FVector& location) const
+{
+	const int32 x = FMath::FloorToInt((location.X - buildOrigin.X) / cellSize);
+	const int32 y = FMath::FloorToInt((location.Y - buildOrigin.Y) / cellSize);
+
+	return x >= recenterMargin && y >= recenterMargin && x < gridSize - recenterMargin && y < gridSize - recenterMargin;
+}
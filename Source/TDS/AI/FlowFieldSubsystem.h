@@ -0,0 +1,125 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "../Game/TDSTickableWorldSubsystem.h"
+#include "FlowFieldSubsystem.generated.h"
+
+// One flow field towards all player pawns on a grid around them, instead of a path per enemy.
+// Walkable cells come from the navmesh, the distance to the players is spread over several frames
+// and the finished field replaces the old one, so every agent reads its direction from a single cell
+UCLASS(Config = Game)
+class TDS_API UFlowFieldSubsystem : public UTDSTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// Cells per side of the square grid
+	UPROPERTY(Config, EditAnywhere, Category = "Flow field")
+	int32 gridSize = 128;
+	UPROPERTY(Config, EditAnywhere, Category = "Flow field")
+	float cellSize = 100.f;
+	// Grid moves to the center of the players once one of them is this many cells from its edge.
+	// Players too far apart for one grid: it moves with their center and the far ones are left out
+	UPROPERTY(Config, EditAnywhere, Category = "Flow field")
+	int32 recenterMargin = 16;
+	// Without the navmesh every cell is walkable
+	UPROPERTY(Config, EditAnywhere, Category = "Flow field")
+	bool bUseNavMesh = true;
+	// Build budgets, the rest goes on in the next frame
+	UPROPERTY(Config, EditAnywhere, Category = "Flow field")
+	int32 costCellsPerFrame = 1024;
+	UPROPERTY(Config, EditAnywhere, Category = "Flow field")
+	int32 integrationCellsPerFrame = 8192;
+	// Agents closer than this push each other apart
+	UPROPERTY(Config, EditAnywhere, Category = "Flow field")
+	float separationRadius = 80.f;
+	UPROPERTY(Config, EditAnywhere, Category = "Flow field")
+	float separationWeight = 1.f;
+
+	// Registered pawns are steered along the field every frame with AddMovementInput
+	UFUNCTION(BlueprintCallable)
+	void RegisterAgent(APawn* agent);
+	UFUNCTION(BlueprintCallable)
+	void UnregisterAgent(APawn* agent);
+
+	// Unit direction in XY of the cell under the location, zero outside the field or where no player can be reached
+	UFUNCTION(BlueprintCallable)
+	FVector GetFlowDirection(const FVector& location) const;
+
+	UFUNCTION(BlueprintCallable)
+	bool IsFieldReady() const;
+	UFUNCTION(BlueprintCallable)
+	int32 GetNumAgents() const;
+
+private:
+	enum class EFlowFieldBuildPhase : uint8
+	{
+		IDLE,
+		COSTS,
+		INTEGRATION
+	};
+
+	// Returns true if a player is in another cell than in the last build
+	bool GatherGoals();
+	// Moves the grid by whole cells, the cells it still covers keep their costs
+	void RecenterGrid(const FVector& center);
+	void StartBuild();
+	void StartIntegration();
+	void BuildCosts();
+	void BuildIntegration();
+	void BuildDirections();
+
+	void SteerAgents();
+	void SortAgentsByCell();
+
+	int32 GetCellIndex(const FVector2D& origin, const FVector& location) const;
+	bool IsInsideInnerArea(const FVector& location) const;
+
+	EFlowFieldBuildPhase buildPhase = EFlowFieldBuildPhase::IDLE;
+
+	// ================================ Build ================================
+	// 1 walkable, 0 blocked, relative to buildOrigin
+	TArray<uint8> cellCosts;
+	TArray<uint8> shiftedCosts;
+	// Cells new to the grid, projected to the navmesh by BuildCosts
+	TArray<int32> pendingCostCells;
+	TArray<int32> integration;
+	// BFS queue, the head moves forward, nothing is removed
+	TArray<int32> openCells;
+	int32 openHead = 0;
+	int32 costCursor = 0;
+	FVector2D buildOrigin = FVector2D::ZeroVector;
+	float buildZ = 0.f;
+	bool bIsCostsValid = false;
+
+	TArray<FVector> goalLocations;
+	TArray<int32> goalCells;
+	TArray<int32> builtGoalCells;
+	TArray<uint8> buildDirections;
+
+	// ================================ Field ================================
+	// Neighbour index per cell (0..7), or a special value for goal and unreachable cells
+	TArray<uint8> flowDirections;
+	FVector2D fieldOrigin = FVector2D::ZeroVector;
+	bool bIsFieldReady = false;
+	// Players of the finished field, agents in a goal cell go straight to the nearest one
+	TArray<FVector> fieldGoalLocations;
+
+	// ================================ Agents ================================
+	TArray<TWeakObjectPtr<APawn>> agents;
+	TArray<FVector> agentLocations;
+	TArray<FVector> agentDirections;
+	TArray<int32> agentCells;
+	// Agents sorted by cell, cellAgentStart[cell]..cellAgentStart[cell + 1] for the separation
+	TArray<int32> sortedAgents;
+	TArray<int32> cellAgentStart;
+};
@@ -0,0 +1,119 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CursorQueryComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/Character.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "GameFramework/PlayerController.h"
+
+#include "../TDSStats.h"
+
+UCursorQueryComponent::UCursorQueryComponent()
+{
+	// Queries are made on demand, nothing to tick
+	PrimaryComponentTick.bCanEverTick = false;
+}
+
+const FHitResult* UCursorQueryComponent::GetHitUnderCursor(ECollisionChannel traceChannel, bool bTraceComplex)
+{
+	APlayerController* myPlayerController = GetOwnerPlayerController();
+	if (!myPlayerController)
+		return nullptr;
+
+	FCursorQuery* myQuery = cursorQueries.FindByPredicate([traceChannel, bTraceComplex](const FCursorQuery& query)
+	{
+		return query.traceChannel == traceChannel && query.bTraceComplex == bTraceComplex;
+	});
+
+	if (!myQuery)
+	{
+		myQuery = &cursorQueries.AddDefaulted_GetRef();
+		myQuery->traceChannel = traceChannel;
+		myQuery->bTraceComplex = bTraceComplex;
+	}
+
+	if (myQuery->frameNumber == GFrameCounter)
+		return &myQuery->hitResult;
+
+	TDS_SCOPE_CYCLE_COUNTER(CursorTrace);
+
+	myQuery->frameNumber = GFrameCounter;
+	myQuery->hitResult = FHitResult();
+
+	if (!UpdateCursorRay(myPlayerController))
+		return &myQuery->hitResult;
+
+	const FVector traceEnd = cursorRayOrigin + cursorRayDirection * myPlayerController->HitResultTraceDistance;
+
+	if (bUseGroundPlane && traceChannel == groundPlaneChannel)
+	{
+		// Ray - plane, no trace
+		const FPlane groundPlane(FVector(0.f, 0.f, GetGroundPlaneHeight()), FVector::UpVector);
+		const float rayDot = FVector::DotProduct(cursorRayDirection, FVector::UpVector);
+
+		if (rayDot < -KINDA_SMALL_NUMBER)
+		{
+			const float hitDistance = -groundPlane.PlaneDot(cursorRayOrigin) / rayDot;
+			const FVector hitLocation = cursorRayOrigin + cursorRayDirection * hitDistance;
+
+			myQuery->hitResult = FHitResult(hitDistance / myPlayerController->HitResultTraceDistance);
+			myQuery->hitResult.bBlockingHit = true;
+			myQuery->hitResult.Distance = hitDistance;
+			myQuery->hitResult.Location = hitLocation;
+			myQuery->hitResult.ImpactPoint = hitLocation;
+			myQuery->hitResult.Normal = FVector::UpVector;
+			myQuery->hitResult.ImpactNormal = FVector::UpVector;
+			myQuery->hitResult.TraceStart = cursorRayOrigin;
+			myQuery->hitResult.TraceEnd = traceEnd;
+		}
+
+		return &myQuery->hitResult;
+	}
+
+	FCollisionQueryParams queryParams(SCENE_QUERY_STAT(CursorQuery), bTraceComplex);
+	GetWorld()->LineTraceSingleByChannel(myQuery->hitResult, cursorRayOrigin, traceEnd, traceChannel, queryParams);
+
+	return &myQuery->hitResult;
+}
+
+bool UCursorQueryComponent::GetCursorHitResult(TEnumAsByte<ECollisionChannel> traceChannel, bool bTraceComplex, FHitResult& outHitResult)
+{
+	const FHitResult* myHitResult = GetHitUnderCursor(traceChannel, bTraceComplex);
+	if (!myHitResult)
+		return false;
+
+	outHitResult = *myHitResult;
+	return myHitResult->bBlockingHit;
+}
+
+APlayerController* UCursorQueryComponent::GetOwnerPlayerController() const
+{
+	APawn* myPawn = Cast<APawn>(GetOwner());
+	return myPawn ? Cast<APlayerController>(myPawn->GetController()) : nullptr;
+}
+
+bool UCursorQueryComponent::UpdateCursorRay(APlayerController* myPlayerController)
+{
+	if (cursorRayFrameNumber != GFrameCounter)
+	{
+		cursorRayFrameNumber = GFrameCounter;
+		bIsCursorRayValid = myPlayerController->DeprojectMousePositionToWorld(cursorRayOrigin, cursorRayDirection);
+	}
+
+	return bIsCursorRayValid;
+}
+
+float UCursorQueryComponent::GetGroundPlaneHeight() const
+{
+	const ACharacter* myCharacter = Cast<ACharacter>(GetOwner());
+
+	if (myCharacter && myCharacter->GetCharacterMovement())
+	{
+		const FFindFloorResult& currentFloor = myCharacter->GetCharacterMovement()->CurrentFloor;
+		if (currentFloor.IsWalkableFloor())
+			return currentFloor.HitResult.ImpactPoint.Z;
+	}
+
+	return GetOwner()->GetActorLocation().Z;
+}
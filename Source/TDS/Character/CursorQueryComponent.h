@@ -0,0 +1,53 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "Engine/EngineTypes.h"
+
+#include "CursorQueryComponent.generated.h"
+
+// Hit results under the cursor of the owning pawn's player, each channel is traced at most once per frame
+UCLASS(ClassGroup = (TDS), meta = (BlueprintSpawnableComponent))
+class TDS_API UCursorQueryComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UCursorQueryComponent();
+
+	// Flat ground: the ray from the cursor is crossed with a plane at the owner's floor instead of a physics trace
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Cursor")
+	bool bUseGroundPlane = true;
+	// "LandscapeCursor" channel from DefaultEngine.ini
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Cursor")
+	TEnumAsByte<ECollisionChannel> groundPlaneChannel = ECC_GameTraceChannel1;
+
+	// Returns null if the owner is not controlled by a player
+	const FHitResult* GetHitUnderCursor(ECollisionChannel traceChannel, bool bTraceComplex = false);
+
+	UFUNCTION(BlueprintCallable)
+	bool GetCursorHitResult(TEnumAsByte<ECollisionChannel> traceChannel, bool bTraceComplex, FHitResult& outHitResult);
+
+private:
+	struct FCursorQuery
+	{
+		ECollisionChannel traceChannel = ECC_Visibility;
+		bool bTraceComplex = false;
+		uint64 frameNumber = 0;
+		FHitResult hitResult;
+	};
+
+	APlayerController* GetOwnerPlayerController() const;
+	bool UpdateCursorRay(APlayerController* myPlayerController);
+	float GetGroundPlaneHeight() const;
+
+	TArray<FCursorQuery, TInlineAllocator<2>> cursorQueries;
+
+	// Mouse deprojection is shared by all channels
+	uint64 cursorRayFrameNumber = 0;
+	bool bIsCursorRayValid = false;
+	FVector cursorRayOrigin = FVector::ZeroVector;
+	FVector cursorRayDirection = FVector::ForwardVector;
+};
@@ -0,0 +1,112 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "HealthComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "GameFramework/Controller.h"
+#include "Net/UnrealNetwork.h"
+
+#include "../Weapons/DamageSubsystem.h"
+#include "../Weapons/RadialDamageSubsystem.h"
+
+UHealthComponent::UHealthComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+	SetIsReplicatedByDefault(true);
+}
+
+void UHealthComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(UHealthComponent, health);
+}
+
+void UHealthComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	AActor* myOwner = GetOwner();
+	if (!myOwner->HasAuthority())
+		return;
+
+	health = maxHealth;
+	myOwner->OnTakeAnyDamage.AddDynamic(this, &UHealthComponent::OnOwnerTakeAnyDamage);
+
+	// Anything with health is in the explosion grid, destroyed owners are dropped by the subsystem itself
+	URadialDamageSubsystem* myRadialDamage = GetWorld()->GetSubsystem<URadialDamageSubsystem>();
+	if (myRadialDamage)
+		myRadialDamage->RegisterDamageTarget(myOwner);
+}
+
+float UHealthComponent::GetHealth() const
+{ return health; }
+
+float UHealthComponent::GetMaxHealth() const
+{ return maxHealth; }
+
+bool UHealthComponent::IsDead() const
+{ return bIsDead; }
+
+void UHealthComponent::ChangeHealth(float value)
+{
+	if (bIsDead || !GetOwner()->HasAuthority())
+		return;
+
+	if (value < 0.f)
+	{
+		ApplyResolvedDamage(-value, 0, nullptr);
+		return;
+	}
+
+	health = FMath::Min(health + value, maxHealth);
+	OnHealthChanged.Broadcast(health, -value, 0, nullptr);
+}
+
+float UHealthComponent::GetBoneMultiplier(FName boneName) const
+{
+	const float* multiplier = boneName.IsNone() ? nullptr : boneDamageMultipliers.Find(boneName);
+	return multiplier ? *multiplier : 1.f;
+}
+
+void UHealthComponent::ApplyResolvedDamage(float damage, int32 numHits, AController* instigator)
+{
+	if (bIsDead || damage <= 0.f)
+		return;
+
+	health = FMath::Max(health - damage, 0.f);
+	OnHealthChanged.Broadcast(health, damage, numHits, instigator);
+
+	if (health > 0.f)
+		return;
+
+	bIsDead = true;
+	OnDeath.Broadcast(instigator);
+}
+
+int32 UHealthComponent::GetResolveIndex() const
+{ return resolveIndex; }
+
+void UHealthComponent::SetResolveIndex(int32 newResolveIndex)
+{ resolveIndex = newResolveIndex; }
+
+void UHealthComponent::OnOwnerTakeAnyDamage(AActor* DamagedActor, float Damage, const UDamageType* DamageType, AController* InstigatedBy, AActor* DamageCauser)
+{
+	UDamageSubsystem* myDamage = GetWorld()->GetSubsystem<UDamageSubsystem>();
+	if (myDamage)
+		myDamage->QueueHealthDamage(this, Damage, InstigatedBy);
+	else
+		ApplyResolvedDamage(FMath::Max(Damage * damageMultiplier - armor, 0.f), 1, InstigatedBy);
+}
+
+void UHealthComponent::OnRep_Health(float oldHealth)
+{
+	OnHealthChanged.Broadcast(health, oldHealth - health, 0, nullptr);
+
+	if (health > 0.f || bIsDead)
+		return;
+
+	bIsDead = true;
+	OnDeath.Broadcast(nullptr);
+}
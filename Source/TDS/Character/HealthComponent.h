@@ -0,0 +1,81 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+
+#include "HealthComponent.generated.h"
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_FourParams(FOnHealthChanged, float, health, float, damage, int32, numHits, AController*, instigator);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnDeath, AController*, killer);
+
+// Hits are not applied one by one: UDamageSubsystem queues them and calls the component once per frame with the sum,
+// so a shotgun blast or a burst is one health change. Health is set by the server and replicated.
+// The owner is registered as a target of URadialDamageSubsystem
+UCLASS(ClassGroup = (TDS), meta = (BlueprintSpawnableComponent))
+class TDS_API UHealthComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UHealthComponent();
+
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+protected:
+	virtual void BeginPlay() override;
+
+public:
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Health")
+	float maxHealth = 100.f;
+	// Taken from every hit, a pellet weaker than the armor does nothing
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Health")
+	float armor = 0.f;
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Health")
+	float damageMultiplier = 1.f;
+	// Point damage on these bones is multiplied, e.g. head = 2
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Health")
+	TMap<FName, float> boneDamageMultipliers;
+
+	// Once per frame with the damage of all hits of the frame, numHits is 0 on clients and for healing
+	UPROPERTY(BlueprintAssignable, Category = "Health")
+	FOnHealthChanged OnHealthChanged;
+	UPROPERTY(BlueprintAssignable, Category = "Health")
+	FOnDeath OnDeath;
+
+	UFUNCTION(BlueprintCallable)
+	float GetHealth() const;
+	UFUNCTION(BlueprintCallable)
+	float GetMaxHealth() const;
+	UFUNCTION(BlueprintCallable)
+	bool IsDead() const;
+
+	// Server only, positive heals. Applied at once, not batched
+	UFUNCTION(BlueprintCallable)
+	void ChangeHealth(float value);
+
+	// 1 for bones without a multiplier
+	float GetBoneMultiplier(FName boneName) const;
+	// Sum of the frame from UDamageSubsystem
+	void ApplyResolvedDamage(float damage, int32 numHits, AController* instigator);
+
+	// ================================ Damage subsystem ================================
+	int32 GetResolveIndex() const;
+	void SetResolveIndex(int32 newResolveIndex);
+
+private:
+	// Damage from other sources (Blueprint ApplyDamage, falling) goes through the same queue
+	UFUNCTION()
+	void OnOwnerTakeAnyDamage(AActor* DamagedActor, float Damage, const class UDamageType* DamageType, AController* InstigatedBy, AActor* DamageCauser);
+
+	UFUNCTION()
+	void OnRep_Health(float oldHealth);
+
+	UPROPERTY(ReplicatedUsing = OnRep_Health)
+	float health = 0.f;
+	bool bIsDead = false;
+
+	// Entry of this frame in the damage subsystem
+	int32 resolveIndex = INDEX_NONE;
+};
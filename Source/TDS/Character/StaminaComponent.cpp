@@ -0,0 +1,151 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "StaminaComponent.h"
+#include "Engine/World.h"
+#include "TimerManager.h"
+#include "Net/UnrealNetwork.h"
+#include "GameFramework/Character.h"
+
+#include "TDSCharacterMovementComponent.h"
+
+UStaminaComponent::UStaminaComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+	SetIsReplicatedByDefault(true);
+}
+
+void UStaminaComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	// The owner runs the same moves as the server and carries the stamina in FSavedMove_TDS for the replays
+	DOREPLIFETIME_CONDITION(UStaminaComponent, replicatedStamina, COND_SimulatedOnly);
+}
+
+void UStaminaComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (ACharacter* myCharacter = Cast<ACharacter>(GetOwner()))
+		characterMovement = Cast<UTDSCharacterMovementComponent>(myCharacter->GetCharacterMovement());
+
+	const float currentTime = GetStaminaTime();
+	staminaState.stamina = maxStamina;
+	staminaState.changeTime = currentTime;
+	staminaState.recoverStartTime = currentTime;
+
+	UpdateReplicatedStamina();
+}
+
+void UStaminaComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	GetWorld()->GetTimerManager().ClearTimer(staminaEventTimer);
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UStaminaComponent::SetDraining(bool bIsDraining, float time, bool bBroadcast)
+{
+	if (staminaState.bIsDraining == bIsDraining)
+		return;
+
+	ApplyStep(TDSSimulation::SetStaminaDraining(staminaState, GetStaminaConfig(), bIsDraining, time), bBroadcast);
+}
+
+float UStaminaComponent::GetStamina() const
+{ return TDSSimulation::GetStamina(staminaState, GetStaminaConfig(), GetStaminaTime()); }
+
+bool UStaminaComponent::IsTired() const
+{ return TDSSimulation::IsStaminaTired(staminaState, GetStaminaConfig(), GetStaminaTime()); }
+
+FStaminaSimConfig UStaminaComponent::GetStaminaConfig() const
+{
+	FStaminaSimConfig staminaConfig;
+	staminaConfig.maxStamina = maxStamina;
+	staminaConfig.decreaseStamina = decreaseStamina;
+	staminaConfig.increaseStamina = increaseStamina;
+	staminaConfig.recoveryFromTired = recoveryFromTired;
+	staminaConfig.timeToRecoverStamina = timeToRecoverStamina;
+	staminaConfig.timeToRecoverStaminaAfterZero = timeToRecoverStaminaAfterZero;
+	return staminaConfig;
+}
+
+// ============================ Saved moves ============================
+const FStaminaSimState& UStaminaComponent::GetStaminaState() const
+{ return staminaState; }
+
+void UStaminaComponent::RestoreStaminaState(const FStaminaSimState& newStaminaState)
+{
+	staminaState = newStaminaState;
+	ScheduleNextEvent();
+}
+
+float UStaminaComponent::GetStaminaTime() const
+{
+	// Simulated proxies don't run the moves, their move clock stands still
+	if (characterMovement && GetOwnerRole() != ROLE_SimulatedProxy)
+		return characterMovement->GetMoveClock();
+
+	return GetWorld()->GetTimeSeconds();
+}
+
+void UStaminaComponent::OnStaminaEvent()
+{ ApplyStep(TDSSimulation::UpdateStamina(staminaState, GetStaminaConfig(), GetStaminaTime())); }
+
+void UStaminaComponent::ApplyStep(const FStaminaSimStep& step, bool bBroadcast)
+{
+	ScheduleNextEvent();
+	UpdateReplicatedStamina();
+
+	if (!bBroadcast)
+		return;
+
+	if (step.bIsExhausted)
+		OnStaminaExhausted.Broadcast();
+	if (step.bIsRecovered)
+		OnStaminaRecovered.Broadcast();
+	if (step.bIsFull)
+		OnStaminaFull.Broadcast();
+}
+
+void UStaminaComponent::ScheduleNextEvent()
+{
+	FTimerManager& timerManager = GetWorld()->GetTimerManager();
+	const float eventTime = TDSSimulation::GetNextStaminaEventTime(staminaState, GetStaminaConfig());
+
+	if (eventTime < 0.f)
+	{
+		timerManager.ClearTimer(staminaEventTimer);
+		return;
+	}
+
+	// Threshold in the past is handled next frame
+	const float delay = FMath::Max(eventTime - GetStaminaTime(), KINDA_SMALL_NUMBER);
+	timerManager.SetTimer(staminaEventTimer, this, &UStaminaComponent::OnStaminaEvent, delay, false);
+}
+
+void UStaminaComponent::UpdateReplicatedStamina()
+{
+	if (!GetOwner() || !GetOwner()->HasAuthority())
+		return;
+
+	const float currentTime = GetStaminaTime();
+	replicatedStamina.stamina = GetStamina();
+	replicatedStamina.recoverDelay = staminaState.bIsDraining ? 0.f : FMath::Max(staminaState.recoverStartTime - currentTime, 0.f);
+	replicatedStamina.bIsDraining = staminaState.bIsDraining;
+	replicatedStamina.bIsTired = staminaState.bIsTired;
+}
+
+void UStaminaComponent::OnRep_ReplicatedStamina()
+{
+	// Rate goes on from the time the values arrived
+	const float currentTime = GetStaminaTime();
+	staminaState.stamina = replicatedStamina.stamina;
+	staminaState.changeTime = currentTime;
+	staminaState.recoverStartTime = currentTime + replicatedStamina.recoverDelay;
+	staminaState.bIsDraining = replicatedStamina.bIsDraining;
+	staminaState.bIsTired = replicatedStamina.bIsTired;
+
+	ScheduleNextEvent();
+}
@@ -0,0 +1,107 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+
+#include "../Simulation/StaminaSimulation.h"
+#include "StaminaComponent.generated.h"
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE(FOnStaminaEvent);
+
+class UTDSCharacterMovementComponent;
+
+// What simulated proxies need to show the stamina of others, sent only when the rate changes
+USTRUCT()
+struct FReplicatedStamina
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	float stamina = 0.f;
+	// Seconds left before the stamina comes back
+	UPROPERTY()
+	float recoverDelay = 0.f;
+	UPROPERTY()
+	bool bIsDraining = false;
+	UPROPERTY()
+	bool bIsTired = false;
+};
+
+// Stamina does not tick: the value is computed from the last change when asked,
+// and one timer waits for the next threshold (empty, recovered from tired, full).
+// The owner and the server time it by the move clock of the character movement, simulated proxies by the world time
+UCLASS(ClassGroup = (TDS), meta = (BlueprintSpawnableComponent))
+class TDS_API UStaminaComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UStaminaComponent();
+
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+public:
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Stamina")
+	float maxStamina = 100.f;
+	// Per second
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Stamina")
+	float decreaseStamina = 1.f;
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Stamina")
+	float increaseStamina = 1.f;
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Stamina")
+	float recoveryFromTired = 40.f;
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Stamina")
+	float timeToRecoverStamina = 0.5f;
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Stamina")
+	float timeToRecoverStaminaAfterZero = 2.f;
+
+	UPROPERTY(BlueprintAssignable, Category = "Stamina")
+	FOnStaminaEvent OnStaminaExhausted;
+	UPROPERTY(BlueprintAssignable, Category = "Stamina")
+	FOnStaminaEvent OnStaminaRecovered;
+	UPROPERTY(BlueprintAssignable, Category = "Stamina")
+	FOnStaminaEvent OnStaminaFull;
+
+	// Sprinting and moving, called by the movement component after every move with its move clock.
+	// Replayed moves pass bBroadcast = false, the events were sent when the move was made
+	void SetDraining(bool bIsDraining, float time, bool bBroadcast = true);
+
+	UFUNCTION(BlueprintCallable)
+	float GetStamina() const;
+	UFUNCTION(BlueprintCallable)
+	bool IsTired() const;
+
+	FStaminaSimConfig GetStaminaConfig() const;
+
+	// ============================ Saved moves ============================
+	const FStaminaSimState& GetStaminaState() const;
+	void RestoreStaminaState(const FStaminaSimState& newStaminaState);
+
+private:
+	// Move clock or world time, see the class comment
+	float GetStaminaTime() const;
+
+	void OnStaminaEvent();
+	// Broadcasts the crossed thresholds and waits for the next one
+	void ApplyStep(const FStaminaSimStep& step, bool bBroadcast = true);
+	void ScheduleNextEvent();
+	void UpdateReplicatedStamina();
+
+	UFUNCTION()
+	void OnRep_ReplicatedStamina();
+
+	UPROPERTY(ReplicatedUsing = OnRep_ReplicatedStamina)
+	FReplicatedStamina replicatedStamina;
+
+	FStaminaSimState staminaState;
+	FTimerHandle staminaEventTimer;
+
+	UPROPERTY()
+	UTDSCharacterMovementComponent* characterMovement = nullptr;
+};
@@ -7,6 +7,7 @@
 #include "Components/CapsuleComponent.h"
 #include "GameFramework/CharacterMovementComponent.h"
 #include "GameFramework/PlayerController.h"
+#include "GameFramework/GameStateBase.h"
 #include "GameFramework/SpringArmComponent.h"
 #include "HeadMountedDisplayFunctionLibrary.h"
 #include "Materials/Material.h"
@@ -15,8 +16,17 @@
 #include "Kismet/GameplayStatics.h"
 #include "Kismet/KismetMathLibrary.h"
 #include "../Game/TDSGameInstance.h"
-
-ATDSCharacter::ATDSCharacter()
+#include "../Game/WeaponRegistrySubsystem.h"
+#include "CursorQueryComponent.h"
+#include "TopDownCameraRigComponent.h"
+#include "StaminaComponent.h"
+#include "HealthComponent.h"
+#include "../Weapons/LagCompensationSubsystem.h"
+#include "../Game/SignificanceSubsystem.h"
+#include "../TDSStats.h"
+
+ATDSCharacter::ATDSCharacter(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer.SetDefaultSubobjectClass<UTDSCharacterMovementComponent>(ACharacter::CharacterMovementComponentName))
 {
 	// Set size for player capsule
 	GetCapsuleComponent()->InitCapsuleSize(42.f, 96.0f);
@@ -46,45 +56,81 @@ ATDSCharacter::ATDSCharacter()
 	TopDownCameraComponent->SetupAttachment(CameraBoom, USpringArmComponent::SocketName);
 	TopDownCameraComponent->bUsePawnControlRotation = false; // Camera does not rotate relative to arm
 
+	// Create a camera rig...
+	CameraRig = CreateDefaultSubobject<UTopDownCameraRigComponent>(TEXT("CameraRig"));
+
+	// Create a cursor query...
+	CursorQuery = CreateDefaultSubobject<UCursorQueryComponent>(TEXT("CursorQuery"));
+
+	// Create a stamina...
+	StaminaComponent = CreateDefaultSubobject<UStaminaComponent>(TEXT("Stamina"));
+
+	// Create a health...
+	HealthComponent = CreateDefaultSubobject<UHealthComponent>(TEXT("Health"));
+
 	// Activate ticking in order to update the cursor every frame.
 	PrimaryActorTick.bCanEverTick = true;
 	PrimaryActorTick.bStartWithTickEnabled = true;
 
 	// Setting the default speed settings
-	currentSpeed = movementSpeedInfo.runSpeed;
-	GetCharacterMovement()->MaxWalkSpeed = currentSpeed;
-	currentStamina = maxStamina;
+	GetCharacterMovement()->MaxWalkSpeed = movementSpeedInfo.runSpeed;
 }
 
 void ATDSCharacter::BeginPlay()
 {
 	Super::BeginPlay();
 
+	CameraRig->minArmLength = minCameraHeight;
+	CameraRig->maxArmLength = maxCameraHeight;
+	CameraRig->zoomStep = changeDistanceSpringArm;
+	CameraRig->SetSpringArm(CameraBoom);
+
+	// Rates are read only when the stamina is asked, nothing has used them yet
+	StaminaComponent->decreaseStamina = decreaseStamina;
+	StaminaComponent->increaseStamina = increaseStamina;
+	StaminaComponent->recoveryFromTired = recoveryFromTired;
+	StaminaComponent->timeToRecoverStamina = timeToRecoverStamina;
+	StaminaComponent->timeToRecoverStaminaAfterZero = timeToRecoverStaminaAfterZero;
+
 	if (cursorMaterial)
 		cursorToWorld = UGameplayStatics::SpawnDecalAtLocation(GetWorld(), cursorMaterial, cursorSize, FVector());
 
+	ULagCompensationSubsystem* myLagCompensation = GetWorld()->GetSubsystem<ULagCompensationSubsystem>();
+	if (myLagCompensation)
+		myLagCompensation->RegisterTarget(this);
+
+	USignificanceSubsystem* mySignificance = GetWorld()->GetSubsystem<USignificanceSubsystem>();
+	if (mySignificance)
+		mySignificance->RegisterActor(this, ESignificanceCategory::CHARACTER);
+
 	InitWeapon(initWeaponName);
 }
 
 void ATDSCharacter::Tick(float DeltaSeconds)
 {
+	TDS_SCOPE_CYCLE_COUNTER(CharacterTick);
+
     Super::Tick(DeltaSeconds);
 
 	if (cursorToWorld)
 	{
-		if (APlayerController* myPC = Cast<APlayerController>(GetController()))
+		if (const FHitResult* traceHitResult = CursorQuery->GetHitUnderCursor(ECC_Visibility, true))
 		{
-			FHitResult traceHitResult;
-			myPC->GetHitResultUnderCursor(ECC_Visibility, true, traceHitResult);
-			FVector CursorFV = traceHitResult.ImpactNormal;
+			FVector CursorFV = traceHitResult->ImpactNormal;
 			FRotator CursorR = CursorFV.Rotation();
 
-			cursorToWorld->SetWorldLocation(traceHitResult.Location);
+			cursorToWorld->SetWorldLocation(traceHitResult->Location);
 			cursorToWorld->SetWorldRotation(CursorR);
 		}
 	}
 
 	MovementTick(DeltaSeconds);
+
+	// Remote players aim with the cursor of their own machine
+	if (bHasServerAim && HasAuthority() && !IsLocallyControlled())
+		SetActorRotation(FRotator(0.f, serverAimYaw, 0.f));
+
+	SyncMovementState();
 }
 
 void ATDSCharacter::SetupPlayerInputComponent(UInputComponent* newInputComponent)
@@ -114,32 +160,23 @@ void ATDSCharacter::InputAxisY(const float value)
 
 void ATDSCharacter::MovementTick(const float deltaTime)
 {
+	TDS_SCOPE_CYCLE_COUNTER(MovementTick);
+
 	AddMovementInput(FVector(1.f, 0.f, 0.f), axisX);
 	AddMovementInput(FVector(0.f, 1.f, 0.f), axisY);
 
-	auto myPlayerController = UGameplayStatics::GetPlayerController(GetWorld(), 0);
+	const FHitResult* resultHit = CursorQuery->GetHitUnderCursor(ECC_GameTraceChannel1, false);
 
-	if (!(IsValid(myPlayerController)))
+	if (!resultHit)
 		return;
 
-	FHitResult resultHit;
-	myPlayerController->GetHitResultUnderCursor(ECC_GameTraceChannel1, false, resultHit);
-
-	if (bIsFastRunning)
+	if (currentStateOfMove != EMovementState::FAST_RUN_STATE)
 	{
-		numberWhichStaminaChanges = (decreaseStamina * deltaTime);
-		ReducesStamina();
-	}
-	else 
-	{
-		auto newActorRotation = UKismetMathLibrary::FindLookAtRotation(GetActorLocation(), resultHit.Location);
+		auto newActorRotation = UKismetMathLibrary::FindLookAtRotation(GetActorLocation(), resultHit->Location);
 		SetActorRotation(FRotator(0.f, newActorRotation.Yaw, 0.f));
-	}
-	
-	if (bIsCanIncreaseStamina)
-	{
-		numberWhichStaminaChanges = (increaseStamina * deltaTime);
-		AugmentStamina();
+
+		if (!HasAuthority())
+			SendAimYaw();
 	}
 }
 
@@ -148,28 +185,14 @@ void ATDSCharacter::MovementTick(const float deltaTime)
 // ============================ Changes the current state of the character ============================
 void ATDSCharacter::CharacterUpdateSpeed()
 {
-	GetWorldTimerManager().ClearTimer(timerToAccelirationSpeed);
-
-	switch (currentStateOfMove)
-	{
-	case EMovementState::AIM_WALK_STATE:
-		currentSpeed = movementSpeedInfo.aimWalkSpeed;
-		break;
-	case EMovementState::WALK_STATE:
-		currentSpeed = movementSpeedInfo.simpleWalkSpeed;
-		break;
-	case EMovementState::AIM_RUN_STATE:
-		currentSpeed = movementSpeedInfo.aimRunSpeed;
-		break;
-	case EMovementState::RUN_STATE:
-		currentSpeed = movementSpeedInfo.runSpeed;
-		break;
-	case EMovementState::FAST_RUN_STATE:
-		currentSpeed = movementSpeedInfo.fastRunSpeed;
-		break;
-	}
+	UTDSCharacterMovementComponent* myMovement = GetTDSMovement();
+	if (!myMovement)
+		return;
 
-	GetWorldTimerManager().SetTimer(timerToAccelirationSpeed, this, &ATDSCharacter::AccelerationAndDeccelerationToMove, 0.002f, true);
+	// Flags go to the server with the saved moves, the next move changes the speed
+	myMovement->SetWantsToWalk(bIsWalking);
+	myMovement->SetWantsToAim(bIsAiming);
+	myMovement->SetWantsToSprint(bIsFastRunning);
 }
 
 void ATDSCharacter::ChangeMovementState()
@@ -178,18 +201,23 @@ void ATDSCharacter::ChangeMovementState()
 	{
 		bIsWalking = false;
 		bIsAiming = false;
-		currentStateOfMove = EMovementState::FAST_RUN_STATE;
 	}
-	else if (bIsWalking && bIsAiming)
-		currentStateOfMove = EMovementState::AIM_WALK_STATE;
-	else if (!bIsWalking && bIsAiming)
-		currentStateOfMove = EMovementState::AIM_RUN_STATE;
-	else if (bIsWalking && !bIsAiming)
-		currentStateOfMove = EMovementState::WALK_STATE;
-	else
-		currentStateOfMove = EMovementState::RUN_STATE;
 
 	CharacterUpdateSpeed();
+}
+
+void ATDSCharacter::SyncMovementState()
+{
+	const UTDSCharacterMovementComponent* myMovement = GetTDSMovement();
+	if (!myMovement)
+		return;
+
+	bIsCharacterTired = StaminaComponent->IsTired();
+
+	if (myMovement->GetMovementState() == currentStateOfMove)
+		return;
+
+	currentStateOfMove = myMovement->GetMovementState();
 
 	// Weapon state update
 	AWeaponActor_Base* myWeapon = GetCurrentWeapon();
@@ -198,150 +226,62 @@ void ATDSCharacter::ChangeMovementState()
 		myWeapon->UpdateStateWeapon(currentStateOfMove);
 }
 
-void ATDSCharacter::AccelerationAndDeccelerationToMove()
-{
-	if (GetCharacterMovement()->MaxWalkSpeed < currentSpeed)
-		GetCharacterMovement()->MaxWalkSpeed += movementSpeedInfo.acceleration;
-	else if (GetCharacterMovement()->MaxWalkSpeed > currentSpeed)
-		GetCharacterMovement()->MaxWalkSpeed -= movementSpeedInfo.acceleration;
-	else
-		GetWorldTimerManager().ClearTimer(timerToAccelirationSpeed);
-}
-
 
 
 // ===================== Zooming in and out of the camera by the teddy bear wheel =====================
 void ATDSCharacter::MouseWheelCameraSlide(const float value)
-{
-	float springArmLength = CameraBoom->TargetArmLength;
-
-	if (value < 0.f && (springArmLength + changeDistanceSpringArm <= maxCameraHeight) && bIsSlideDone)
-	{
-		GetWorldTimerManager().SetTimer(timerToSmooth, this, &ATDSCharacter::AddsSmoothnessToTheCamera, 0.001, true);
-		isSlideUp = 1;
-		bIsSlideDone = false;
-	}
-	else if (value > 0.f && (springArmLength - changeDistanceSpringArm >= minCameraHeight) && bIsSlideDone)
-	{
-		GetWorldTimerManager().SetTimer(timerToSmooth, this, &ATDSCharacter::AddsSmoothnessToTheCamera, 0.001, true);
-		isSlideUp = -1;
-		bIsSlideDone = false;
-	}
-}
-
-void ATDSCharacter::AddsSmoothnessToTheCamera()
-{
-	float changeSlideStepDistance = 1.f;
-	currentSlideDistance += changeSlideStepDistance;
+{ CameraRig->AddZoomInput(value); }
 
-	CameraBoom->TargetArmLength += isSlideUp;
-	if (currentSlideDistance >= changeDistanceSpringArm)
-	{
-		bIsSlideDone = true;
-		currentSlideDistance = 0.f;
-		GetWorldTimerManager().ClearTimer(timerToSmooth);
-	}
-
-}
 
 
+// =========================================== Weapon =================================================
 
-// ============================================= STAMINA ==============================================
-void ATDSCharacter::ReducesStamina()
+void ATDSCharacter::InitWeapon(FName idWeapon)
 {
-	if (!GetVelocity().IsZero())
-	{
-		bIsCanIncreaseStamina = false;
-		bIsStartsTimerToIncreaseStamina = false;
-		currentStamina -= numberWhichStaminaChanges;
-	}
-
-	if (!bIsStartsTimerToIncreaseStamina)
-	{
-		GetWorldTimerManager().ClearTimer(timerToAugmentStamina);
-
-		if (currentStamina <= 0.f)
-		{
-			currentStamina = 0.f;
+	TDS_SCOPE_CYCLE_COUNTER(InitWeapon);
 
-			bIsFastRunning = false;
-			bIsCharacterTired = true;
-			ChangeMovementState();
+	UGameInstance* myGameInstance = GetGameInstance();
+	UWeaponRegistrySubsystem* myRegistry = myGameInstance ? myGameInstance->GetSubsystem<UWeaponRegistrySubsystem>() : nullptr;
 
-			GetWorldTimerManager().SetTimer(timerToAugmentStamina, this, &ATDSCharacter::ChangeCanIncreaseStamina, timeToRecoverStaminaAfterZero, false);
-			return;
-		}
-
-		GetWorldTimerManager().SetTimer(timerToAugmentStamina, this, &ATDSCharacter::ChangeCanIncreaseStamina, timeToRecoverStamina, false);
+	if (myRegistry)
+	{
+		const FWeaponHandle myWeaponHandle = myRegistry->FindWeapon(idWeapon);
 
-		bIsStartsTimerToIncreaseStamina = true;
+		// Weapon is spawned once its sounds, effects and meshes are streamed in
+		if (myWeaponHandle.IsValid())
+			myRegistry->RequestWeaponAssets(myWeaponHandle, FStreamableDelegate::CreateUObject(this, &ATDSCharacter::SpawnWeapon, myWeaponHandle));
+		else
+			UE_LOG(LogTemp, Warning, TEXT("InitWeapon = ERROR! - Weapon nor found in table. "));
 	}
 }
 
-void ATDSCharacter::AugmentStamina()
+void ATDSCharacter::SpawnWeapon(FWeaponHandle weaponHandle)
 {
-	currentStamina += numberWhichStaminaChanges;
+	UGameInstance* myGameInstance = GetGameInstance();
+	UWeaponRegistrySubsystem* myRegistry = myGameInstance ? myGameInstance->GetSubsystem<UWeaponRegistrySubsystem>() : nullptr;
+	const FWeaponInfo* myWeaponInfo = myRegistry ? myRegistry->GetWeaponInfo(weaponHandle) : nullptr;
 
-	if (currentStamina >= recoveryFromTired)
+	if (myWeaponInfo && myWeaponInfo->weaponClass)
 	{
-		bIsCharacterTired = false;
+		FVector SpawnLocation = FVector(0);
+		FRotator SpawnRotation = FRotator(0);
 
-		auto myPlayerController = UGameplayStatics::GetPlayerController(GetWorld(), 0);
-		FKey shiftKey = EKeys::LeftShift;
+		// Every machine spawns its own copy, the weapon itself is not replicated (see MulticastShotBatch)
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		SpawnParams.Owner = GetOwner();
+		SpawnParams.Instigator = GetInstigator();
 
-		if (myPlayerController->IsInputKeyDown(shiftKey))
+		AWeaponActor_Base* myWeapon = Cast<AWeaponActor_Base>(GetWorld()->SpawnActor(myWeaponInfo->weaponClass, &SpawnLocation, &SpawnRotation, SpawnParams));
+		if (myWeapon)
 		{
-			bIsFastRunning = true;
-			ChangeMovementState();
-		}
-	}
+			FAttachmentTransformRules Rule(EAttachmentRule::SnapToTarget, false);
+			myWeapon->AttachToComponent(GetMesh(), Rule, FName("WeaponSocketRightHand"));
+			currentWeapon = myWeapon;
 
-	if (currentStamina >= maxStamina)
-	{
-		currentStamina = maxStamina;
-		bIsCanIncreaseStamina = false;
-	}
-}
-
-void ATDSCharacter::ChangeCanIncreaseStamina()
-{ bIsCanIncreaseStamina = true; }
-
-// =========================================== Weapon =================================================
-
-void ATDSCharacter::InitWeapon(FName idWeapon) //ToDo Init by id row by table
-{
-	UTDSGameInstance* myGameInstance = Cast<UTDSGameInstance>(GetGameInstance());
-	FWeaponInfo myWeaponInfo;
-
-	if (myGameInstance)
-	{
-		if (myGameInstance->GetWeaponInfoByName(idWeapon, myWeaponInfo))
-		{
-			if (myWeaponInfo.weaponClass)
-			{
-				FVector SpawnLocation = FVector(0);
-				FRotator SpawnRotation = FRotator(0);
-
-				FActorSpawnParameters SpawnParams;
-				SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
-				SpawnParams.Owner = GetOwner();
-				SpawnParams.Instigator = GetInstigator();
-
-				AWeaponActor_Base* myWeapon = Cast<AWeaponActor_Base>(GetWorld()->SpawnActor(myWeaponInfo.weaponClass, &SpawnLocation, &SpawnRotation, SpawnParams));
-				if (myWeapon)
-				{
-					FAttachmentTransformRules Rule(EAttachmentRule::SnapToTarget, false);
-					myWeapon->AttachToComponent(GetMesh(), Rule, FName("WeaponSocketRightHand"));
-					currentWeapon = myWeapon;
-
-					myWeapon->SetWeaponSettings(myWeaponInfo);
-					myWeapon->UpdateStateWeapon(currentStateOfMove);
-					myWeapon->reloadTimer = myWeapon->weaponSettings.reloadTime;
-				}
-			}
+			myWeapon->SetWeaponDefinition(weaponHandle);
+			myWeapon->UpdateStateWeapon(currentStateOfMove);
 		}
-		else
-			UE_LOG(LogTemp, Warning, TEXT("InitWeapon = ERROR! - Weapon nor found in table. "));
 	}
 }
 
@@ -349,9 +289,12 @@ void ATDSCharacter::InitWeapon(FName idWeapon) //ToDo Init by id row by table
 
 void ATDSCharacter::TryReloadWeapon()
 {
+	if (!HasAuthority() && IsLocallyControlled())
+		ServerReloadWeapon();
+
 	if (currentWeapon)
 	{
-		if (currentWeapon->GetWeaponRound() < currentWeapon->weaponSettings.maxRound)
+		if (currentWeapon->GetWeaponRound() < currentWeapon->GetWeaponSettings().maxRound)
 		{
 			currentWeapon->InitReload();
 		}
@@ -366,6 +309,9 @@ void ATDSCharacter::InputAttackReleased()
 
 void ATDSCharacter::AttackCharEvent(bool bIsFiring)
 {
+	if (!HasAuthority() && IsLocallyControlled())
+		ServerSetTrigger(bIsFiring, GetClientServerTime());
+
 	AWeaponActor_Base* myWeapon = nullptr;
 	myWeapon = GetCurrentWeapon();
 
@@ -378,12 +324,90 @@ void ATDSCharacter::AttackCharEvent(bool bIsFiring)
 		UE_LOG(LogTemp, Warning, TEXT("ATDCharacter::AttachCharEvent - CurrentWeapon - NULL"));
 }
 
+// ============================ Network ============================
+void ATDSCharacter::MulticastShotBatch_Implementation(const FWeaponShotBatch& shotBatch)
+{
+	// Server fired the batch itself, the owner predicted it
+	if (HasAuthority() || IsLocallyControlled())
+		return;
+
+	if (currentWeapon)
+		currentWeapon->ReplayShotBatch(shotBatch);
+}
+
+void ATDSCharacter::ServerSetTrigger_Implementation(bool bIsFiring, float clientTime)
+{
+	UpdateLagCompensationDelay(clientTime);
+	AttackCharEvent(bIsFiring);
+}
+
+void ATDSCharacter::ServerReloadWeapon_Implementation()
+{ TryReloadWeapon(); }
+
+void ATDSCharacter::ServerSetAimYaw_Implementation(uint16 aimYaw, float clientTime)
+{
+	UpdateLagCompensationDelay(clientTime);
+
+	serverAimYaw = FRotator::DecompressAxisFromShort(aimYaw);
+	bHasServerAim = true;
+	SetActorRotation(FRotator(0.f, serverAimYaw, 0.f));
+}
+
+void ATDSCharacter::SendAimYaw()
+{
+	const uint16 aimYaw = FRotator::CompressAxisToShort(GetActorRotation().Yaw);
+	const float currentTime = GetWorld()->GetTimeSeconds();
+
+	if (aimYaw == lastSentAimYaw || currentTime - lastAimSendTime < 1.f / aimSendRate)
+		return;
+
+	ServerSetAimYaw(aimYaw, GetClientServerTime());
+	lastSentAimYaw = aimYaw;
+	lastAimSendTime = currentTime;
+}
+
+void ATDSCharacter::UpdateLagCompensationDelay(float clientTime)
+{
+	// Server time on the client is one trip behind, so the gap is the round trip:
+	// the others reached the client one trip late and the RPC took another one to get here
+	lagCompensationDelay = FMath::Max(GetWorld()->GetTimeSeconds() - clientTime, 0.f);
+}
+
+float ATDSCharacter::GetClientServerTime() const
+{
+	const AGameStateBase* myGameState = GetWorld()->GetGameState();
+	return myGameState ? myGameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds();
+}
+
 // ===================================== Getters and setters ==========================================
 float ATDSCharacter::GetCurrentStamina() const
-{ return currentStamina; }
+{ return StaminaComponent->GetStamina(); }
+
+UTDSCharacterMovementComponent* ATDSCharacter::GetTDSMovement() const
+{ return Cast<UTDSCharacterMovementComponent>(GetCharacterMovement()); }
 
 UDecalComponent* ATDSCharacter::GetCursorToWorld()
 { return cursorToWorld; }
 
 AWeaponActor_Base* ATDSCharacter::GetCurrentWeapon() const
 { return currentWeapon; }
+
+float ATDSCharacter::GetLagCompensationDelay() const
+{ return lagCompensationDelay; }
+
+FVector ATDSCharacter::GetAimDirection()
+{
+	// Sprinting character does not turn to the cursor, see MovementTick
+	const FHitResult* resultHit = IsLocallyControlled() && currentStateOfMove != EMovementState::FAST_RUN_STATE
+		? CursorQuery->GetHitUnderCursor(ECC_GameTraceChannel1, false)
+		: nullptr;
+
+	if (resultHit)
+	{
+		const FVector aimDirection = (resultHit->Location - GetActorLocation()).GetSafeNormal2D();
+		if (!aimDirection.IsNearlyZero())
+			return aimDirection;
+	}
+
+	return GetActorForwardVector().GetSafeNormal2D();
+}
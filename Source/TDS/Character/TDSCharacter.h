@@ -7,6 +7,7 @@
 
 #include "../FuncLibrary/Types.h"
 #include "../Weapons/WeaponActor_Base.h"
+#include "TDSCharacterMovementComponent.h"
 
 #include "TDSCharacter.generated.h"
 
@@ -24,7 +25,7 @@ class ATDSCharacter : public ACharacter
 	GENERATED_BODY()
 
 public:
-	ATDSCharacter();
+	ATDSCharacter(const FObjectInitializer& ObjectInitializer);
 
 	// Called once at the beginning of the game
 	virtual void BeginPlay() override;
@@ -38,6 +39,14 @@ public:
 	FORCEINLINE class UCameraComponent* GetTopDownCameraComponent() const { return TopDownCameraComponent; }
 	/** Returns CameraBoom subobject **/
 	FORCEINLINE class USpringArmComponent* GetCameraBoom() const { return CameraBoom; }
+	/** Returns CameraRig subobject **/
+	FORCEINLINE class UTopDownCameraRigComponent* GetCameraRig() const { return CameraRig; }
+	/** Returns CursorQuery subobject **/
+	FORCEINLINE class UCursorQueryComponent* GetCursorQuery() const { return CursorQuery; }
+	/** Returns StaminaComponent subobject **/
+	FORCEINLINE class UStaminaComponent* GetStaminaComponent() const { return StaminaComponent; }
+	/** Returns HealthComponent subobject **/
+	FORCEINLINE class UHealthComponent* GetHealthComponent() const { return HealthComponent; }
 
 private:
 	/** Top down camera */
@@ -48,6 +57,22 @@ private:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Camera, meta = (AllowPrivateAccess = "true"))
 	class USpringArmComponent* CameraBoom;
 
+	/** Camera zoom driven by the mouse wheel */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Camera, meta = (AllowPrivateAccess = "true"))
+	class UTopDownCameraRigComponent* CameraRig;
+
+	/** Cached traces under the cursor, shared by aiming, cursor decal and weapons */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Cursor, meta = (AllowPrivateAccess = "true"))
+	class UCursorQueryComponent* CursorQuery;
+
+	/** Stamina computed from its last change, no tick */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Stamina, meta = (AllowPrivateAccess = "true"))
+	class UStaminaComponent* StaminaComponent;
+
+	/** Health changed once per frame by the damage subsystem */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Health, meta = (AllowPrivateAccess = "true"))
+	class UHealthComponent* HealthComponent;
+
 public:
 
 	// ============================= Cursor =============================
@@ -90,6 +115,7 @@ public:
 
 
 	// ===================== Variables for stamina ======================
+	// Given to the StaminaComponent in BeginPlay, like the zoom to the camera rig
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Stamina")
 	float decreaseStamina = 1.f;
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Stamina")
@@ -109,7 +135,7 @@ public:
 
 	// ============================ Public Weapon ===========================
 	UFUNCTION(BlueprintCallable)
-	void InitWeapon(FName idWeapon); //ToDo Init by id row by table
+	void InitWeapon(FName idWeapon);
 	UFUNCTION(BlueprintCallable)
 	void TryReloadWeapon();
 
@@ -117,6 +143,11 @@ public:
 	UFUNCTION(BlueprintCallable)
 	void AttackCharEvent(bool bIsFiring);
 
+	// ============================= Network ================================
+	// Shots of one weapon tick, replayed by the other clients without damage
+	UFUNCTION(NetMulticast, Unreliable)
+	void MulticastShotBatch(const FWeaponShotBatch& shotBatch);
+
 private:
 	// ================ Functions for movement character ================
 	UFUNCTION()
@@ -127,61 +158,23 @@ private:
 	void MovementTick(const float deltaTime);
 
 	// =========== Changes the current state of the character ============
+	// Speed and its transition are advanced by UTDSCharacterMovementComponent inside the predicted move
 	UFUNCTION(BlueprintCallable)
 	void CharacterUpdateSpeed();
 
 	UFUNCTION(BlueprintCallable)
 	void ChangeMovementState();
-	UFUNCTION()
-	void AccelerationAndDeccelerationToMove();
-		// ============ Variables for change movement
-		UPROPERTY()
-		float currentSpeed;
-		UPROPERTY()
-		FTimerHandle timerToAccelirationSpeed;
+	// Takes the state of the last move, sprint ends there when the character gets tired
+	void SyncMovementState();
 
 
 	// Zooming in and out of the camera by the teddy bear wheel
-		// Variables for smooth slide
-		UPROPERTY()
-		bool bIsSlideDone = true;
-		UPROPERTY()
-		int isSlideUp;
-		UPROPERTY()
-		float currentSlideDistance = 0.f;
-		UPROPERTY()
-		FTimerHandle timerToSmooth;
-
-
 	UFUNCTION()
 	void MouseWheelCameraSlide(const float value);
 
-	UFUNCTION()
-	void AddsSmoothnessToTheCamera();
-
-
-	// ============================= STAMINA ================================
-		// Variables for stamina
-		const float maxStamina = 100.f;
-		UPROPERTY()
-		float currentStamina = 0.f;
-		UPROPERTY()
-		float numberWhichStaminaChanges;
-		UPROPERTY()
-		FTimerHandle timerToAugmentStamina;
-		UPROPERTY()
-		bool bIsCanIncreaseStamina = false;
-		UPROPERTY()
-		bool bIsStartsTimerToIncreaseStamina = false;
-
-	UFUNCTION()
-	void ReducesStamina();
-	UFUNCTION()
-	void AugmentStamina();
-	UFUNCTION()
-	void ChangeCanIncreaseStamina();
 
 	// =========================== Weapon private ===========================
+	void SpawnWeapon(FWeaponHandle weaponHandle);
 	UPROPERTY()
 	AWeaponActor_Base* currentWeapon = nullptr;
 
@@ -190,15 +183,46 @@ private:
 	void InputAttackPressed();
 	void InputAttackReleased();
 
+	// ============================ Network private ============================
+	// The owning client predicts its own shots, the server fires the ones which deal damage
+	UFUNCTION(Server, Reliable)
+	void ServerSetTrigger(bool bIsFiring, float clientTime);
+	UFUNCTION(Server, Reliable)
+	void ServerReloadWeapon();
+	// Yaw is compressed to 16 bits and sent at most aimSendRate times per second
+	UFUNCTION(Server, Unreliable)
+	void ServerSetAimYaw(uint16 aimYaw, float clientTime);
+
+	void SendAimYaw();
+	// clientTime is the server time as the client estimates it when it sent the RPC
+	void UpdateLagCompensationDelay(float clientTime);
+	float GetClientServerTime() const;
+		// Variables for aim
+		const float aimSendRate = 30.f;
+		uint16 lastSentAimYaw = 0;
+		float lastAimSendTime = 0.f;
+		float serverAimYaw = 0.f;
+		bool bHasServerAim = false;
+		float lagCompensationDelay = 0.f;
+
 public: // ===================== Getters and setters ========================
 
 	UFUNCTION(BlueprintCallable)
 	float GetCurrentStamina() const;
 
+	UTDSCharacterMovementComponent* GetTDSMovement() const;
+
 	UFUNCTION(BlueprintCallable)
 	UDecalComponent* GetCursorToWorld();
 
 	UFUNCTION(BlueprintCallable)
 	AWeaponActor_Base* GetCurrentWeapon() const;
+
+	// How far back the server rewinds the targets for the shots of this character
+	float GetLagCompensationDelay() const;
+
+	// Flat direction to the cursor for the local player, from the same cached query as the rotation.
+	// Elsewhere the yaw of the actor, which is the aim yaw the player sent, not the bone of the muzzle
+	FVector GetAimDirection();
 };
 
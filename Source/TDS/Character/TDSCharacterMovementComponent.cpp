@@ -0,0 +1,263 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TDSCharacterMovementComponent.h"
+#include "Curves/CurveFloat.h"
+
+#include "TDSCharacter.h"
+#include "StaminaComponent.h"
+
+// ============================ Saved moves ============================
+class FSavedMove_TDS : public FSavedMove_Character
+{
+public:
+	typedef FSavedMove_Character Super;
+
+	virtual void Clear() override
+	{
+		Super::Clear();
+
+		bSavedWantsToWalk = false;
+		bSavedWantsToAim = false;
+		bSavedWantsToSprint = false;
+		savedSpeedState = FTDSSpeedState();
+		savedMoveClock = 0.f;
+		savedStaminaState = FStaminaSimState();
+	}
+
+	virtual uint8 GetCompressedFlags() const override
+	{
+		uint8 result = Super::GetCompressedFlags();
+
+		if (bSavedWantsToWalk)
+			result |= FLAG_Custom_0;
+		if (bSavedWantsToAim)
+			result |= FLAG_Custom_1;
+		if (bSavedWantsToSprint)
+			result |= FLAG_Custom_2;
+
+		return result;
+	}
+
+	virtual bool CanCombineWith(const FSavedMovePtr& NewMove, ACharacter* InCharacter, float MaxDelta) const override
+	{
+		const FSavedMove_TDS* newMove = static_cast<const FSavedMove_TDS*>(NewMove.Get());
+
+		if (bSavedWantsToWalk != newMove->bSavedWantsToWalk || bSavedWantsToAim != newMove->bSavedWantsToAim || bSavedWantsToSprint != newMove->bSavedWantsToSprint)
+			return false;
+
+		return Super::CanCombineWith(NewMove, InCharacter, MaxDelta);
+	}
+
+	virtual void CombineWith(const FSavedMove_Character* OldMove, ACharacter* InCharacter, APlayerController* PC, const FVector& OldStartLocation) override
+	{
+		Super::CombineWith(OldMove, InCharacter, PC, OldStartLocation);
+
+		// Combined move is simulated again from the start of the old one
+		const FSavedMove_TDS* oldMove = static_cast<const FSavedMove_TDS*>(OldMove);
+		savedSpeedState = oldMove->savedSpeedState;
+		savedMoveClock = oldMove->savedMoveClock;
+		savedStaminaState = oldMove->savedStaminaState;
+
+		if (UTDSCharacterMovementComponent* myMovement = Cast<UTDSCharacterMovementComponent>(InCharacter->GetCharacterMovement()))
+			myMovement->RestoreMoveState(savedSpeedState, savedMoveClock, savedStaminaState);
+	}
+
+	virtual void SetMoveFor(ACharacter* C, float InDeltaTime, FVector const& NewAccel, FNetworkPredictionData_Client_Character& ClientData) override
+	{
+		Super::SetMoveFor(C, InDeltaTime, NewAccel, ClientData);
+
+		const UTDSCharacterMovementComponent* myMovement = Cast<UTDSCharacterMovementComponent>(C->GetCharacterMovement());
+		if (!myMovement)
+			return;
+
+		bSavedWantsToWalk = myMovement->WantsToWalk();
+		bSavedWantsToAim = myMovement->WantsToAim();
+		bSavedWantsToSprint = myMovement->WantsToSprint();
+		savedSpeedState = myMovement->GetSpeedState();
+		savedMoveClock = myMovement->GetMoveClock();
+		savedStaminaState = myMovement->GetStaminaState();
+	}
+
+	virtual void PrepMoveFor(ACharacter* C) override
+	{
+		Super::PrepMoveFor(C);
+
+		if (UTDSCharacterMovementComponent* myMovement = Cast<UTDSCharacterMovementComponent>(C->GetCharacterMovement()))
+			myMovement->RestoreMoveState(savedSpeedState, savedMoveClock, savedStaminaState);
+	}
+
+	bool bSavedWantsToWalk = false;
+	bool bSavedWantsToAim = false;
+	bool bSavedWantsToSprint = false;
+
+	// State at the start of the move. Stamina gates the sprint, so a replay has to start from the stamina of the original move
+	FTDSSpeedState savedSpeedState;
+	float savedMoveClock = 0.f;
+	FStaminaSimState savedStaminaState;
+};
+
+class FNetworkPredictionData_Client_TDS : public FNetworkPredictionData_Client_Character
+{
+public:
+	typedef FNetworkPredictionData_Client_Character Super;
+
+	FNetworkPredictionData_Client_TDS(const UCharacterMovementComponent& ClientMovement)
+		: Super(ClientMovement)
+	{}
+
+	virtual FSavedMovePtr AllocateNewMove() override
+	{ return FSavedMovePtr(new FSavedMove_TDS()); }
+};
+
+// ============================ UTDSCharacterMovementComponent ============================
+void UTDSCharacterMovementComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	speedState.currentSpeed = MaxWalkSpeed;
+
+	if (CharacterOwner)
+		staminaComponent = CharacterOwner->FindComponentByClass<UStaminaComponent>();
+}
+
+void UTDSCharacterMovementComponent::UpdateFromCompressedFlags(uint8 Flags)
+{
+	Super::UpdateFromCompressedFlags(Flags);
+
+	bIsWantsToWalk = (Flags & FSavedMove_Character::FLAG_Custom_0) != 0;
+	bIsWantsToAim = (Flags & FSavedMove_Character::FLAG_Custom_1) != 0;
+	bIsWantsToSprint = (Flags & FSavedMove_Character::FLAG_Custom_2) != 0;
+}
+
+FNetworkPredictionData_Client* UTDSCharacterMovementComponent::GetPredictionData_Client() const
+{
+	if (!ClientPredictionData)
+	{
+		UTDSCharacterMovementComponent* mutableThis = const_cast<UTDSCharacterMovementComponent*>(this);
+		mutableThis->ClientPredictionData = new FNetworkPredictionData_Client_TDS(*this);
+	}
+
+	return ClientPredictionData;
+}
+
+void UTDSCharacterMovementComponent::UpdateCharacterStateBeforeMovement(float DeltaSeconds)
+{
+	Super::UpdateCharacterStateBeforeMovement(DeltaSeconds);
+
+	// Client and server add the same deltas, the stamina of the move is read at the same time on both
+	moveClock += DeltaSeconds;
+
+	// The move runs with the speed of its own flags
+	SpeedStep(DeltaSeconds);
+}
+
+void UTDSCharacterMovementComponent::OnMovementUpdated(float DeltaSeconds, const FVector& OldLocation, const FVector& OldVelocity)
+{
+	Super::OnMovementUpdated(DeltaSeconds, OldLocation, OldVelocity);
+
+	// Simulated proxies don't run the moves, their stamina comes from the server
+	if (!staminaComponent || !CharacterOwner || CharacterOwner->GetLocalRole() == ROLE_SimulatedProxy)
+		return;
+
+	// Sprint drains only if the move went somewhere. Replayed moves don't broadcast the thresholds again
+	staminaComponent->SetDraining(speedState.movementState == EMovementState::FAST_RUN_STATE && !Velocity.IsZero(), moveClock, !bClientUpdating);
+}
+
+// ================================= Input flags =================================
+void UTDSCharacterMovementComponent::SetWantsToWalk(bool bWantsToWalk)
+{ bIsWantsToWalk = bWantsToWalk; }
+
+void UTDSCharacterMovementComponent::SetWantsToAim(bool bWantsToAim)
+{ bIsWantsToAim = bWantsToAim; }
+
+void UTDSCharacterMovementComponent::SetWantsToSprint(bool bWantsToSprint)
+{ bIsWantsToSprint = bWantsToSprint; }
+
+bool UTDSCharacterMovementComponent::WantsToWalk() const
+{ return bIsWantsToWalk; }
+
+bool UTDSCharacterMovementComponent::WantsToAim() const
+{ return bIsWantsToAim; }
+
+bool UTDSCharacterMovementComponent::WantsToSprint() const
+{ return bIsWantsToSprint; }
+
+// ================================= Getters =================================
+EMovementState UTDSCharacterMovementComponent::GetMovementState() const
+{ return speedState.movementState; }
+
+float UTDSCharacterMovementComponent::GetMoveClock() const
+{ return moveClock; }
+
+// ============================ Saved moves ============================
+const FTDSSpeedState& UTDSCharacterMovementComponent::GetSpeedState() const
+{ return speedState; }
+
+FStaminaSimState UTDSCharacterMovementComponent::GetStaminaState() const
+{ return staminaComponent ? staminaComponent->GetStaminaState() : FStaminaSimState(); }
+
+void UTDSCharacterMovementComponent::RestoreMoveState(const FTDSSpeedState& newSpeedState, float newMoveClock, const FStaminaSimState& newStaminaState)
+{
+	speedState = newSpeedState;
+	MaxWalkSpeed = speedState.currentSpeed;
+	moveClock = newMoveClock;
+
+	if (staminaComponent)
+		staminaComponent->RestoreStaminaState(newStaminaState);
+}
+
+EMovementState UTDSCharacterMovementComponent::GetWantedMovementState() const
+{
+	// Tired character keeps running until the stamina is back over recoveryFromTired
+	if (bIsWantsToSprint && !(staminaComponent && staminaComponent->IsTired()))
+		return EMovementState::FAST_RUN_STATE;
+	if (bIsWantsToWalk && bIsWantsToAim)
+		return EMovementState::AIM_WALK_STATE;
+	if (bIsWantsToAim)
+		return EMovementState::AIM_RUN_STATE;
+	if (bIsWantsToWalk)
+		return EMovementState::WALK_STATE;
+
+	return EMovementState::RUN_STATE;
+}
+
+void UTDSCharacterMovementComponent::SpeedStep(float deltaTime)
+{
+	const ATDSCharacter* myCharacter = Cast<ATDSCharacter>(CharacterOwner);
+	if (!myCharacter)
+		return;
+
+	const FCharacterSpeed& speedInfo = myCharacter->movementSpeedInfo;
+	const EMovementState newMovementState = GetWantedMovementState();
+
+	// Start the transition from the current speed, the curve is taken by the state change
+	if (newMovementState != speedState.movementState)
+	{
+		const EMovementState previousMovementState = speedState.movementState;
+		speedState.transitionIndex = speedInfo.speedTransitions.IndexOfByPredicate([previousMovementState, newMovementState](const FSpeedTransition& transition)
+		{
+			return transition.fromState == previousMovementState && transition.toState == newMovementState;
+		});
+		speedState.transitionStartSpeed = speedState.currentSpeed;
+		speedState.transitionTime = 0.f;
+		speedState.movementState = newMovementState;
+	}
+
+	const float targetSpeed = speedInfo.GetSpeed(newMovementState);
+	const FSpeedTransition* myTransition = speedInfo.speedTransitions.IsValidIndex(speedState.transitionIndex) ? &speedInfo.speedTransitions[speedState.transitionIndex] : nullptr;
+
+	if (myTransition && myTransition->speedCurve && myTransition->duration > 0.f)
+	{
+		speedState.transitionTime += deltaTime;
+		const float alpha = FMath::Clamp(speedState.transitionTime / myTransition->duration, 0.f, 1.f);
+
+		speedState.currentSpeed = alpha < 1.f
+			? FMath::Lerp(speedState.transitionStartSpeed, targetSpeed, myTransition->speedCurve->GetFloatValue(alpha))
+			: targetSpeed;
+	}
+	else
+		speedState.currentSpeed = FMath::FInterpConstantTo(speedState.currentSpeed, targetSpeed, deltaTime, speedInfo.acceleration);
+
+	MaxWalkSpeed = speedState.currentSpeed;
+}
@@ -0,0 +1,77 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/CharacterMovementComponent.h"
+
+#include "../FuncLibrary/Types.h"
+#include "../Simulation/StaminaSimulation.h"
+#include "TDSCharacterMovementComponent.generated.h"
+
+// Speed of the movement state and the transition to it
+struct FTDSSpeedState
+{
+	EMovementState movementState = EMovementState::RUN_STATE;
+	float currentSpeed = 0.f;
+	float transitionStartSpeed = 0.f;
+	float transitionTime = 0.f;
+	// Index in FCharacterSpeed::speedTransitions, INDEX_NONE moves with the constant acceleration
+	int32 transitionIndex = INDEX_NONE;
+};
+
+// Walk, aim and sprint go with every saved move as compressed flags. Speed is advanced inside the move and
+// the stamina is told when the sprint starts or stops, on the client and on the server alike, so both end the move at the same place.
+// Stamina is timed by the move clock (the sum of the move deltas) instead of the world time, so a replayed move gives the same value as on the server
+UCLASS()
+class TDS_API UTDSCharacterMovementComponent : public UCharacterMovementComponent
+{
+	GENERATED_BODY()
+
+public:
+	virtual void BeginPlay() override;
+
+	virtual void UpdateFromCompressedFlags(uint8 Flags) override;
+	virtual FNetworkPredictionData_Client* GetPredictionData_Client() const override;
+
+protected:
+	virtual void UpdateCharacterStateBeforeMovement(float DeltaSeconds) override;
+	virtual void OnMovementUpdated(float DeltaSeconds, const FVector& OldLocation, const FVector& OldVelocity) override;
+
+public:
+	// ================================= Input flags =================================
+	void SetWantsToWalk(bool bWantsToWalk);
+	void SetWantsToAim(bool bWantsToAim);
+	void SetWantsToSprint(bool bWantsToSprint);
+
+	bool WantsToWalk() const;
+	bool WantsToAim() const;
+	bool WantsToSprint() const;
+
+	// ================================= Getters =================================
+	// State of the last move, sprint ends on its own when the character is tired
+	EMovementState GetMovementState() const;
+
+	// Time of the moves simulated so far, only differences of it mean anything
+	float GetMoveClock() const;
+
+	// ============================ Saved moves ============================
+	const FTDSSpeedState& GetSpeedState() const;
+	FStaminaSimState GetStaminaState() const;
+	// A replayed move starts from the state it started from the first time
+	void RestoreMoveState(const FTDSSpeedState& newSpeedState, float newMoveClock, const FStaminaSimState& newStaminaState);
+
+private:
+	EMovementState GetWantedMovementState() const;
+	void SpeedStep(float deltaTime);
+
+	bool bIsWantsToWalk = false;
+	bool bIsWantsToAim = false;
+	bool bIsWantsToSprint = false;
+
+	FTDSSpeedState speedState;
+	float moveClock = 0.f;
+
+	UPROPERTY()
+	class UStaminaComponent* staminaComponent = nullptr;
+};
@@ -0,0 +1,68 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TopDownCameraRigComponent.h"
+#include "GameFramework/SpringArmComponent.h"
+
+UTopDownCameraRigComponent::UTopDownCameraRigComponent()
+{
+	// Ticks only while the camera is moving to the target
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
+}
+
+void UTopDownCameraRigComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	if (!springArm || zoomSmoothTime <= 0.f)
+	{
+		if (springArm)
+			springArm->TargetArmLength = targetArmLength;
+		armLengthVelocity = 0.f;
+		SetComponentTickEnabled(false);
+		return;
+	}
+
+	// Critically damped spring (Game Programming Gems 4, 1.10)
+	const float omega = 2.f / zoomSmoothTime;
+	const float x = omega * DeltaTime;
+	const float decay = 1.f / (1.f + x + 0.48f * x * x + 0.235f * x * x * x);
+	const float change = springArm->TargetArmLength - targetArmLength;
+	const float temp = (armLengthVelocity + omega * change) * DeltaTime;
+
+	armLengthVelocity = (armLengthVelocity - omega * temp) * decay;
+	springArm->TargetArmLength = targetArmLength + (change + temp) * decay;
+
+	if (FMath::Abs(springArm->TargetArmLength - targetArmLength) < 0.5f && FMath::Abs(armLengthVelocity) < 1.f)
+	{
+		springArm->TargetArmLength = targetArmLength;
+		armLengthVelocity = 0.f;
+		SetComponentTickEnabled(false);
+	}
+}
+
+void UTopDownCameraRigComponent::SetSpringArm(USpringArmComponent* newSpringArm)
+{
+	springArm = newSpringArm;
+
+	if (springArm)
+		targetArmLength = FMath::Clamp(springArm->TargetArmLength, minArmLength, maxArmLength);
+}
+
+void UTopDownCameraRigComponent::AddZoomInput(float value)
+{
+	if (!springArm || FMath::IsNearlyZero(value))
+		return;
+
+	const float newTargetArmLength = FMath::Clamp(targetArmLength - FMath::Sign(value) * zoomStep, minArmLength, maxArmLength);
+
+	if (FMath::IsNearlyEqual(newTargetArmLength, targetArmLength))
+		return;
+
+	targetArmLength = newTargetArmLength;
+	SetComponentTickEnabled(true);
+}
+
+bool UTopDownCameraRigComponent::IsZooming() const
+{ return IsComponentTickEnabled(); }
@@ -0,0 +1,50 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+
+#include "TopDownCameraRigComponent.generated.h"
+
+class USpringArmComponent;
+
+// Zoom of the top down camera: wheel input moves the target arm length, the arm follows it with a critically damped spring
+UCLASS(ClassGroup = (TDS), meta = (BlueprintSpawnableComponent))
+class TDS_API UTopDownCameraRigComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UTopDownCameraRigComponent();
+
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Camera Zoom")
+	float minArmLength = 700.f;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Camera Zoom")
+	float maxArmLength = 1200.f;
+	// Arm length change for one wheel step
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Camera Zoom")
+	float zoomStep = 100.f;
+	// About the time to reach the target
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Camera Zoom")
+	float zoomSmoothTime = 0.2f;
+
+	UFUNCTION(BlueprintCallable)
+	void SetSpringArm(USpringArmComponent* newSpringArm);
+
+	// Wheel value, negative moves the camera away. Input during a zoom adds to the target
+	UFUNCTION(BlueprintCallable)
+	void AddZoomInput(float value);
+
+	UFUNCTION(BlueprintCallable)
+	bool IsZooming() const;
+
+private:
+	UPROPERTY()
+	USpringArmComponent* springArm = nullptr;
+
+	float targetArmLength = 0.f;
+	float armLengthVelocity = 0.f;
+};
@@ -1,4 +1,106 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
 #include "Types.h"
-#include "../TDS.h"
\ No newline at end of file
+#include "../TDS.h"
+
+void FWeaponInfo::GetSoftAssetPaths(TArray<FSoftObjectPath>& outAssetPaths) const
+{
+	const FSoftObjectPath assetPaths[] =
+	{
+		soundFireWeapon.ToSoftObjectPath(),
+		soundReloadWeapon.ToSoftObjectPath(),
+		effectFireWeapon.ToSoftObjectPath(),
+		decalOnHit.ToSoftObjectPath(),
+		effectOnHit.ToSoftObjectPath(),
+		animCharFire.ToSoftObjectPath(),
+		animCharReload.ToSoftObjectPath(),
+		magazineDrop.ToSoftObjectPath(),
+		sleeveBullets.ToSoftObjectPath()
+	};
+
+	for (const FSoftObjectPath& assetPath : assetPaths)
+		if (assetPath.IsValid())
+			outAssetPaths.AddUnique(assetPath);
+}
+
+float FCharacterSpeed::GetSpeed(EMovementState movementState) const
+{
+	switch (movementState)
+	{
+	case EMovementState::AIM_WALK_STATE:
+		return aimWalkSpeed;
+	case EMovementState::WALK_STATE:
+		return simpleWalkSpeed;
+	case EMovementState::AIM_RUN_STATE:
+		return aimRunSpeed;
+	case EMovementState::FAST_RUN_STATE:
+		return fastRunSpeed;
+	default:
+		return runSpeed;
+	}
+}
+
+FDispersionState FWeaponDispersion::GetDispersionState(EMovementState movementState) const
+{
+	FDispersionState dispersionState;
+
+	switch (movementState)
+	{
+	case EMovementState::AIM_WALK_STATE:
+	case EMovementState::AIM_RUN_STATE:
+		dispersionState.start = dispersionAimStart;
+		dispersionState.max = dispersionAimMax;
+		dispersionState.min = dispersionAimMin;
+		dispersionState.shootCoef = dispersionAimShootCoef;
+		break;
+	case EMovementState::WALK_STATE:
+		dispersionState.start = dispersionWalkStart;
+		dispersionState.max = dispersionWalkMax;
+		dispersionState.min = dispersionWalkMin;
+		dispersionState.shootCoef = dispersionWalkShootCoef;
+		break;
+	default:
+		dispersionState.start = dispersionRunStart;
+		dispersionState.max = dispersionRunMax;
+		dispersionState.min = dispersionRunMin;
+		dispersionState.shootCoef = dispersionRunShootCoef;
+		break;
+	}
+
+	return dispersionState;
+}
+
+bool FWeaponShotBatch::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	uint32 handleIndex = weaponHandle.index + 1;
+	Ar.SerializeIntPacked(handleIndex);
+	weaponHandle.index = int32(handleIndex) - 1;
+
+	bool bIsOriginSerialized = true;
+	origin.NetSerialize(Ar, Map, bIsOriginSerialized);
+	bool bIsDirectionSerialized = true;
+	direction.NetSerialize(Ar, Map, bIsDirectionSerialized);
+	bOutSuccess = bIsOriginSerialized && bIsDirectionSerialized;
+
+	Ar.SerializeIntPacked(sampleIndex);
+
+	// Hundredths of a degree, the cone never goes past a few degrees
+	uint16 dispersionQuantized = uint16(FMath::Clamp(FMath::RoundToInt(dispersion * 100.f), 0, int32(MAX_uint16)));
+	Ar << dispersionQuantized;
+	dispersion = dispersionQuantized / 100.f;
+
+	uint8 movementStateBits = uint8(movementState);
+	Ar.SerializeBits(&movementStateBits, 3);
+	movementState = EMovementState(movementStateBits);
+
+	Ar << numShots;
+
+	// Milliseconds, a shot is never due more than a frame ago
+	uint8 firstShotOffsetMs = uint8(FMath::Clamp(FMath::RoundToInt(firstShotOffset * 1000.f), 0, int32(MAX_uint8)));
+	Ar << firstShotOffsetMs;
+	firstShotOffset = firstShotOffsetMs / 1000.f;
+
+	Ar << timeStamp;
+
+	return bOutSuccess && !Ar.IsError();
+}
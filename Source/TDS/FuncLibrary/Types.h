@@ -4,6 +4,7 @@
 
 #include "Kismet/BlueprintFunctionLibrary.h"
 #include "Engine/DataTable.h"
+#include "Engine/NetSerialization.h"
 
 #include "Types.generated.h"
 
@@ -17,6 +18,31 @@ enum class EMovementState : uint8
 	FAST_RUN_STATE UMETA(DisplayName = "Fast Run State")
 };
 
+UENUM(BlueprintType)
+enum class EWeaponState : uint8
+{
+	IDLE_STATE UMETA(DisplayName = "Idle State"),
+	FIRING_STATE UMETA(DisplayName = "Firing State"),
+	COOLDOWN_STATE UMETA(DisplayName = "Cooldown State"),
+	RELOADING_STATE UMETA(DisplayName = "Reloading State")
+};
+
+USTRUCT(BlueprintType)
+struct FSpeedTransition
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Movement")
+	EMovementState fromState = EMovementState::RUN_STATE;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Movement")
+	EMovementState toState = EMovementState::FAST_RUN_STATE;
+	// Time and value from 0 to 1, value is the blend between the old and the new speed
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Movement")
+	class UCurveFloat* speedCurve = nullptr;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Movement")
+	float duration = 0.5f;
+};
+
 USTRUCT(BlueprintType)
 struct FCharacterSpeed
 {
@@ -36,10 +62,16 @@ struct FCharacterSpeed
 
 
 
+	// Speed change per second when there is no curve for the transition
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Movement")
-	float acceleration = 1.f;
+	float acceleration = 500.f;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Movement")
 	float fastRunSpeed = 900.f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Movement")
+	TArray<FSpeedTransition> speedTransitions;
+
+	float GetSpeed(EMovementState movementState) const;
 };
 
 USTRUCT(BlueprintType)
@@ -63,12 +95,34 @@ struct FProjectileInfo
 	bool bIsLikeBomp = false;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ProjectileSettings")
 	float projectileMaxRadiusDamage = 200.f;
+	// Full damage inside this radius, then it falls off to projectileMinDamage at projectileMaxRadiusDamage
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ProjectileSettings")
+	float projectileMinRadiusDamage = 50.f;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ProjectileSettings")
+	float projectileMinDamage = 0.f;
+	// Exponent of the falloff between the radiuses (1 = linear)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ProjectileSettings")
+	float projectileDamageFalloff = 1.f;
+
+	// Round is moved by the projectile simulation without spawning an actor (mesh, speed and collision come from projectile class)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ProjectileSettings")
+	bool bIsSimulated = false;
+};
+
+// Cone half angles (degrees) of one movement state
+struct FDispersionState
+{
+	float start = 0.f;
+	float max = 0.f;
+	float min = 0.f;
+	float shootCoef = 0.f;
 };
 
 USTRUCT(BlueprintType)
 struct FWeaponDispersion
 {
 	GENERATED_BODY()
+	// Aim walk and aim run states
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Dispersion")
 	float dispersionAimStart = 0.5f;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Dispersion")
@@ -77,6 +131,31 @@ struct FWeaponDispersion
 	float dispersionAimMin = 0.1f;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Dispersion")
 	float dispersionAimShootCoef = 1.f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Dispersion")
+	float dispersionWalkStart = 1.f;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Dispersion")
+	float dispersionWalkMax = 3.f;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Dispersion")
+	float dispersionWalkMin = 0.5f;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Dispersion")
+	float dispersionWalkShootCoef = 1.f;
+
+	// Run and fast run states
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Dispersion")
+	float dispersionRunStart = 2.f;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Dispersion")
+	float dispersionRunMax = 6.f;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Dispersion")
+	float dispersionRunMin = 1.f;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Dispersion")
+	float dispersionRunShootCoef = 1.5f;
+
+	// Degrees per second the spread goes back to the min of the state
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Dispersion")
+	float dispersionRecovery = 2.f;
+
+	FDispersionState GetDispersionState(EMovementState movementState) const;
 };
 
 USTRUCT(BlueprintType)
@@ -97,12 +176,13 @@ struct FWeaponInfo : public FTableRowBase
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Dispersion")
 	FWeaponDispersion dispersionWeapon;
 
+	// Assets are soft references, loading the table doesn't load every weapon of the game
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Sound")
-	USoundBase* soundFireWeapon = nullptr;
+	TSoftObjectPtr<USoundBase> soundFireWeapon;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Sound")
-	USoundBase* soundReloadWeapon = nullptr;
+	TSoftObjectPtr<USoundBase> soundReloadWeapon;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "FX")
-	UParticleSystem* effectFireWeapon = nullptr;
+	TSoftObjectPtr<UParticleSystem> effectFireWeapon;
 	// If null use trace logic (TSubclassOf<class AWeaponActor_Base> weaponClass = nullptr)
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Projectile")
 	FProjectileInfo projectileSettings;
@@ -110,19 +190,41 @@ struct FWeaponInfo : public FTableRowBase
 	float weaponDamage = 20.f;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Trace")
 	float distanceTrace = 2000.f;
-	// One decal or all ?
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HitEffect")
-	UDecalComponent* decalOnHit = nullptr;
+	TSoftObjectPtr<UMaterialInterface> decalOnHit;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HitEffect")
+	FVector decalOnHitSize = FVector(10.f, 20.f, 20.f);
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HitEffect")
+	float decalOnHitLifeTime = 10.f;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HitEffect")
+	TSoftObjectPtr<UParticleSystem> effectOnHit;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Anim")
-	UAnimMontage* animCharFire = nullptr;
+	TSoftObjectPtr<UAnimMontage> animCharFire;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Anim")
-	UAnimMontage* animCharReload = nullptr;
+	TSoftObjectPtr<UAnimMontage> animCharReload;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Mesh")
-	UStaticMesh* magazineDrop = nullptr;
+	TSoftObjectPtr<UStaticMesh> magazineDrop;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Mesh")
-	UStaticMesh* sleeveBullets = nullptr;
+	TSoftObjectPtr<UStaticMesh> sleeveBullets;
+
+	// Assets streamed in by the weapon registry before the weapon is used
+	void GetSoftAssetPaths(TArray<FSoftObjectPath>& outAssetPaths) const;
+};
+
+// Index of a weapon definition in the weapon registry
+USTRUCT(BlueprintType)
+struct FWeaponHandle
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "Weapon")
+	int32 index = INDEX_NONE;
+
+	bool IsValid() const { return index != INDEX_NONE; }
+	bool operator==(const FWeaponHandle& other) const { return index == other.index; }
+	bool operator!=(const FWeaponHandle& other) const { return index != other.index; }
 };
 
 USTRUCT(BlueprintType)
@@ -134,6 +236,62 @@ struct FAddicionalWeaponInfo
 	int32 round = 10;
 };
 
+// One round fired by a weapon, timeOffset is how long ago within the frame the shot should have happened
+USTRUCT(BlueprintType)
+struct FWeaponShot
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadWrite, Category = "Shot")
+	FVector location = FVector::ZeroVector;
+	UPROPERTY(BlueprintReadWrite, Category = "Shot")
+	FVector direction = FVector::ForwardVector;
+	UPROPERTY(BlueprintReadWrite, Category = "Shot")
+	float timeOffset = 0.f;
+};
+
+// All shots of one weapon tick as sent by the server. Directions are rebuilt from the dispersion table,
+// so the batch is the same size for one shot or a whole burst
+USTRUCT()
+struct FWeaponShotBatch
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FWeaponHandle weaponHandle;
+	UPROPERTY()
+	FVector_NetQuantize origin;
+	UPROPERTY()
+	FVector_NetQuantizeNormal direction;
+	// Dispersion table index of the first shot (seed + shot counter)
+	UPROPERTY()
+	uint32 sampleIndex = 0;
+	// Cone half angle in degrees before the first shot
+	UPROPERTY()
+	float dispersion = 0.f;
+	UPROPERTY()
+	EMovementState movementState = EMovementState::RUN_STATE;
+	UPROPERTY()
+	uint8 numShots = 0;
+	UPROPERTY()
+	float firstShotOffset = 0.f;
+	// Server world time of the tick which fired the batch
+	UPROPERTY()
+	float timeStamp = 0.f;
+
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+
+	// What the quantized fields can carry, a longer tick is split into several batches
+	static int32 GetMaxShots() { return MAX_uint8; }
+	static float GetMaxFirstShotOffset() { return MAX_uint8 / 1000.f; }
+};
+
+template<>
+struct TStructOpsTypeTraits<FWeaponShotBatch> : public TStructOpsTypeTraitsBase2<FWeaponShotBatch>
+{
+	enum { WithNetSerializer = true };
+};
+
 UCLASS()
 class TDS_API UTypes : public UBlueprintFunctionLibrary
 {
@@ -0,0 +1,311 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SignificanceSubsystem.h"
+#include "Engine/World.h"
+#include "Engine/Engine.h"
+#include "Engine/LocalPlayer.h"
+#include "Engine/GameViewportClient.h"
+#include "GameFramework/PlayerController.h"
+#include "Camera/PlayerCameraManager.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Particles/ParticleSystemComponent.h"
+#include "SceneView.h"
+#include "DrawDebugHelpers.h"
+#include "HAL/IConsoleManager.h"
+
+#include "../TDSStats.h"
+
+static TAutoConsoleVariable<bool> CVarSignificanceDebug(
+	TEXT("tds.Significance.Debug"),
+	false,
+	TEXT("Draws a point over every registered actor (green high, yellow medium, red low) and the tier counts per category."));
+
+bool USignificanceSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{ return Super::ShouldCreateSubsystem(Outer) && !IsRunningDedicatedServer(); }
+
+void USignificanceSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	updateInterval = FMath::Max(updateInterval, 0.f);
+	maxDistance = FMath::Max(maxDistance, 1.f);
+}
+
+void USignificanceSubsystem::Deinitialize()
+{
+	actors.Empty();
+	actorKeys.Empty();
+	actorCategories.Empty();
+	actorTiers.Empty();
+	baseTickIntervals.Empty();
+	actorScores.Empty();
+	actorOnScreen.Empty();
+	actorIndices.Empty();
+	rankedActors.Empty();
+
+	Super::Deinitialize();
+}
+
+TStatId USignificanceSubsystem::GetStatId() const
+{ RETURN_QUICK_DECLARE_CYCLE_STAT(USignificanceSubsystem, STATGROUP_Tickables); }
+
+void USignificanceSubsystem::Tick(float DeltaTime)
+{
+	const float currentTime = GetWorld()->GetTimeSeconds();
+
+	if (currentTime >= nextUpdateTime)
+	{
+		TDS_SCOPE_CYCLE_COUNTER(Significance);
+
+		nextUpdateTime = currentTime + updateInterval;
+
+		for (int32 i = actors.Num() - 1; i >= 0; --i)
+		{
+			if (!actors[i].IsValid())
+				RemoveActorAt(i);
+		}
+
+		if (UpdateView())
+		{
+			ScoreActors();
+			AssignTiers();
+		}
+	}
+
+	int32 lowActors = 0;
+	for (const ESignificanceTier tier : actorTiers)
+		lowActors += tier == ESignificanceTier::LOW ? 1 : 0;
+	TDS_SET_COUNTER(LowSignificanceActors, lowActors);
+
+#if ENABLE_DRAW_DEBUG
+	if (CVarSignificanceDebug.GetValueOnGameThread())
+		DrawDebug();
+#endif
+}
+
+void USignificanceSubsystem::RegisterActor(AActor* actor, ESignificanceCategory category)
+{
+	if (!actor)
+		return;
+
+	// Address of a destroyed actor may be taken by a new one before the next update
+	if (const int32* existingIndex = actorIndices.Find(actor))
+	{
+		if (actors[*existingIndex].IsValid())
+			return;
+		RemoveActorAt(*existingIndex);
+	}
+
+	actorIndices.Add(actor, actors.Num());
+	actors.Add(actor);
+	actorKeys.Add(actor);
+	actorCategories.Add(category);
+	actorTiers.Add(ESignificanceTier::HIGH);
+	baseTickIntervals.Add(actor->GetActorTickInterval());
+}
+
+void USignificanceSubsystem::UnregisterActor(AActor* actor)
+{
+	const int32* index = actorIndices.Find(actor);
+	if (!index)
+		return;
+
+	const int32 removedIndex = *index;
+	if (actors[removedIndex].IsValid())
+		ApplyTier(removedIndex, ESignificanceTier::HIGH);
+
+	RemoveActorAt(removedIndex);
+}
+
+ESignificanceTier USignificanceSubsystem::GetActorTier(const AActor* actor) const
+{
+	const int32* index = actorIndices.Find(actor);
+	return index ? actorTiers[*index] : ESignificanceTier::HIGH;
+}
+
+int32 USignificanceSubsystem::GetNumActors(ESignificanceCategory category, ESignificanceTier tier) const
+{
+	int32 numActors = 0;
+	for (int32 i = 0; i < actors.Num(); ++i)
+		numActors += actorCategories[i] == category && actorTiers[i] == tier ? 1 : 0;
+	return numActors;
+}
+
+bool USignificanceSubsystem::UpdateView()
+{
+	APlayerController* myController = GetWorld()->GetFirstPlayerController();
+	ULocalPlayer* myLocalPlayer = myController ? myController->GetLocalPlayer() : nullptr;
+	if (!myLocalPlayer || !myLocalPlayer->ViewportClient || !myController->PlayerCameraManager)
+		return false;
+
+	// Same projection as ProjectWorldLocationToScreen, built once for all actors
+	FSceneViewProjectionData projectionData;
+	if (!myLocalPlayer->GetProjectionData(myLocalPlayer->ViewportClient->Viewport, eSSP_FULL, projectionData))
+		return false;
+
+	viewProjectionMatrix = projectionData.ComputeViewProjectionMatrix();
+	viewRect = projectionData.GetConstrainedViewRect();
+
+	// Top-down camera looks down at the ground of its view target
+	const FVector cameraLocation = myController->PlayerCameraManager->GetCameraLocation();
+	const FVector cameraForward = myController->PlayerCameraManager->GetCameraRotation().Vector();
+	const AActor* myViewTarget = myController->GetViewTarget();
+	const float groundZ = myViewTarget ? myViewTarget->GetActorLocation().Z : 0.f;
+
+	footprintCenter = cameraForward.Z < -KINDA_SMALL_NUMBER
+		? cameraLocation + cameraForward * ((groundZ - cameraLocation.Z) / cameraForward.Z)
+		: cameraLocation;
+
+	return true;
+}
+
+void USignificanceSubsystem::ScoreActors()
+{
+	const FVector2D margin = FVector2D(viewRect.Width(), viewRect.Height()) * screenMargin;
+
+	actorScores.SetNumUninitialized(actors.Num());
+	actorOnScreen.SetNumUninitialized(actors.Num());
+
+	for (int32 i = 0; i < actors.Num(); ++i)
+	{
+		const AActor* myActor = actors[i].Get();
+
+		// Pooled projectiles wait hidden
+		if (myActor->IsHidden())
+		{
+			actorScores[i] = 0.f;
+			actorOnScreen[i] = false;
+			continue;
+		}
+
+		const FVector location = myActor->GetActorLocation();
+		FVector2D screenLocation;
+
+		actorOnScreen[i] = FSceneView::ProjectWorldToScreen(location, viewRect, viewProjectionMatrix, screenLocation)
+			&& screenLocation.X >= viewRect.Min.X - margin.X && screenLocation.X <= viewRect.Max.X + margin.X
+			&& screenLocation.Y >= viewRect.Min.Y - margin.Y && screenLocation.Y <= viewRect.Max.Y + margin.Y;
+
+		// On screen goes before any distance
+		const float distanceScore = FMath::Clamp(1.f - FVector::Dist2D(location, footprintCenter) / maxDistance, 0.f, 1.f);
+		actorScores[i] = (actorOnScreen[i] ? 1.f : 0.f) + distanceScore;
+	}
+}
+
+void USignificanceSubsystem::AssignTiers()
+{
+	for (const FSignificanceBudget& budget : budgets)
+	{
+		// First budget of a category is the one used
+		if (FindBudget(budget.category) != &budget)
+			continue;
+
+		rankedActors.Reset();
+		for (int32 i = 0; i < actors.Num(); ++i)
+		{
+			if (actorCategories[i] == budget.category)
+				rankedActors.Add(i);
+		}
+
+		rankedActors.Sort([this](int32 a, int32 b) { return actorScores[a] > actorScores[b]; });
+
+		for (int32 rank = 0; rank < rankedActors.Num(); ++rank)
+		{
+			const int32 index = rankedActors[rank];
+			ESignificanceTier newTier = ESignificanceTier::LOW;
+
+			if (rank < budget.maxHighActors && actorOnScreen[index])
+				newTier = ESignificanceTier::HIGH;
+			else if (rank < budget.maxHighActors + budget.maxMediumActors && actorScores[index] > 0.f)
+				newTier = ESignificanceTier::MEDIUM;
+
+			ApplyTier(index, newTier);
+		}
+	}
+}
+
+void USignificanceSubsystem::ApplyTier(int32 index, ESignificanceTier newTier)
+{
+	if (actorTiers[index] == newTier)
+		return;
+
+	actorTiers[index] = newTier;
+
+	AActor* myActor = actors[index].Get();
+	const FSignificanceBudget* budget = FindBudget(actorCategories[index]);
+
+	// Skeletal meshes of the game tick every frame at the full rate
+	float tickInterval = baseTickIntervals[index];
+	float animInterval = 0.f;
+	EParticleSignificanceLevel requiredSignificance = EParticleSignificanceLevel::Low;
+
+	if (budget && newTier == ESignificanceTier::MEDIUM)
+	{
+		tickInterval = FMath::Max(tickInterval, budget->mediumTickInterval);
+		animInterval = budget->mediumAnimInterval;
+		requiredSignificance = EParticleSignificanceLevel::Medium;
+	}
+	else if (budget && newTier == ESignificanceTier::LOW)
+	{
+		tickInterval = FMath::Max(tickInterval, budget->lowTickInterval);
+		animInterval = budget->lowAnimInterval;
+		requiredSignificance = EParticleSignificanceLevel::High;
+	}
+
+	if (myActor->PrimaryActorTick.bCanEverTick)
+		myActor->SetActorTickInterval(tickInterval);
+
+	TInlineComponentArray<USkeletalMeshComponent*> meshes(myActor);
+	for (USkeletalMeshComponent* mesh : meshes)
+		mesh->SetComponentTickInterval(animInterval);
+
+	// Emitters below the required level of the particle system are not spawned
+	TInlineComponentArray<UParticleSystemComponent*> emitters(myActor);
+	for (UParticleSystemComponent* emitter : emitters)
+		emitter->SetRequiredSignificance(requiredSignificance);
+}
+
+void USignificanceSubsystem::RemoveActorAt(int32 index)
+{
+	const int32 lastIndex = actors.Num() - 1;
+
+	actorIndices.Remove(actorKeys[index]);
+	if (index != lastIndex)
+		actorIndices.Add(actorKeys[lastIndex], index);
+
+	actors.RemoveAtSwap(index);
+	actorKeys.RemoveAtSwap(index);
+	actorCategories.RemoveAtSwap(index);
+	actorTiers.RemoveAtSwap(index);
+	baseTickIntervals.RemoveAtSwap(index);
+}
+
+void USignificanceSubsystem::DrawDebug() const
+{
+	static const FColor tierColors[] = { FColor::Green, FColor::Yellow, FColor::Red };
+	UWorld* world = GetWorld();
+
+	for (int32 i = 0; i < actors.Num(); ++i)
+	{
+		if (const AActor* myActor = actors[i].Get())
+			DrawDebugPoint(world, myActor->GetActorLocation() + FVector(0.f, 0.f, 100.f), 12.f, tierColors[static_cast<uint8>(actorTiers[i])]);
+	}
+
+	DrawDebugSphere(world, footprintCenter, 50.f, 8, FColor::Cyan);
+
+	if (!GEngine)
+		return;
+
+	const UEnum* categoryEnum = StaticEnum<ESignificanceCategory>();
+	for (const FSignificanceBudget& budget : budgets)
+	{
+		GEngine->AddOnScreenDebugMessage(INDEX_NONE, 0.f, FColor::White, FString::Printf(TEXT("%s: %d high, %d medium, %d low"),
+			*categoryEnum->GetDisplayNameTextByValue(static_cast<int64>(budget.category)).ToString(),
+			GetNumActors(budget.category, ESignificanceTier::HIGH),
+			GetNumActors(budget.category, ESignificanceTier::MEDIUM),
+			GetNumActors(budget.category, ESignificanceTier::LOW)));
+	}
+}
+
+const FSignificanceBudget* USignificanceSubsystem::FindBudget(ESignificanceCategory category) const
+{ return budgets.FindByPredicate([category](const FSignificanceBudget& budget) { return budget.category == category; }); }
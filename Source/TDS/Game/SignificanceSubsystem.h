@@ -0,0 +1,125 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "TDSTickableWorldSubsystem.h"
+#include "SignificanceSubsystem.generated.h"
+
+UENUM(BlueprintType)
+enum class ESignificanceCategory : uint8
+{
+	CHARACTER UMETA(DisplayName = "Character"),
+	WEAPON UMETA(DisplayName = "Weapon"),
+	PROJECTILE UMETA(DisplayName = "Projectile"),
+	WORLD_ITEM UMETA(DisplayName = "World Item")
+};
+
+UENUM(BlueprintType)
+enum class ESignificanceTier : uint8
+{
+	HIGH UMETA(DisplayName = "High"),
+	MEDIUM UMETA(DisplayName = "Medium"),
+	LOW UMETA(DisplayName = "Low")
+};
+
+// How many actors of a category get the full rate and what the others are lowered to
+USTRUCT()
+struct FSignificanceBudget
+{
+	GENERATED_BODY()
+
+	UPROPERTY(Config)
+	ESignificanceCategory category = ESignificanceCategory::CHARACTER;
+	// High only on screen, medium also near the view, the rest is low
+	UPROPERTY(Config)
+	int32 maxHighActors = 16;
+	UPROPERTY(Config)
+	int32 maxMediumActors = 32;
+
+	// Seconds between actor ticks, never below the interval of the actor itself
+	UPROPERTY(Config)
+	float mediumTickInterval = 0.f;
+	UPROPERTY(Config)
+	float lowTickInterval = 0.f;
+	// Seconds between skeletal mesh ticks, the animation is stepped in between
+	UPROPERTY(Config)
+	float mediumAnimInterval = 0.f;
+	UPROPERTY(Config)
+	float lowAnimInterval = 0.f;
+};
+
+// Actors are scored by the camera of the local player: being on screen, then the distance to the point the top-down camera looks at.
+// The best of each category stay at the full rate, the others tick, animate and spawn FX less. Scores are updated a few times a second
+// and the actors are touched only when their tier changes. Nothing is lowered on a dedicated server
+UCLASS(Config = Game)
+class TDS_API USignificanceSubsystem : public UTDSTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Significance")
+	float updateInterval = 0.1f;
+	// From the camera footprint, actors further away only count as off screen
+	UPROPERTY(Config, EditAnywhere, Category = "Significance")
+	float maxDistance = 5000.f;
+	// Part of the viewport size around the screen which still counts as on screen
+	UPROPERTY(Config, EditAnywhere, Category = "Significance")
+	float screenMargin = 0.1f;
+	// Category without a budget stays high
+	UPROPERTY(Config, EditAnywhere, Category = "Significance")
+	TArray<FSignificanceBudget> budgets;
+
+	// Destroyed actors are dropped by the subsystem itself
+	UFUNCTION(BlueprintCallable)
+	void RegisterActor(AActor* actor, ESignificanceCategory category);
+	UFUNCTION(BlueprintCallable)
+	void UnregisterActor(AActor* actor);
+
+	// High for actors which are not registered
+	UFUNCTION(BlueprintCallable)
+	ESignificanceTier GetActorTier(const AActor* actor) const;
+
+	UFUNCTION(BlueprintCallable)
+	int32 GetNumActors(ESignificanceCategory category, ESignificanceTier tier) const;
+
+private:
+	// Returns false when there is no local camera
+	bool UpdateView();
+	void ScoreActors();
+	void AssignTiers();
+	void ApplyTier(int32 index, ESignificanceTier newTier);
+	void RemoveActorAt(int32 index);
+	void DrawDebug() const;
+
+	const FSignificanceBudget* FindBudget(ESignificanceCategory category) const;
+
+	float nextUpdateTime = 0.f;
+
+	// ================================ Actors ================================
+	TArray<TWeakObjectPtr<AActor>> actors;
+	// Only a key for actorIndices, also after the actor is gone
+	TArray<const AActor*> actorKeys;
+	TArray<ESignificanceCategory> actorCategories;
+	TArray<ESignificanceTier> actorTiers;
+	TArray<float> baseTickIntervals;
+	TArray<float> actorScores;
+	TArray<bool> actorOnScreen;
+	TMap<const AActor*, int32> actorIndices;
+
+	// Actors of one category, best score first
+	TArray<int32> rankedActors;
+
+	// ================================ View ================================
+	FVector footprintCenter = FVector::ZeroVector;
+	FMatrix viewProjectionMatrix = FMatrix::Identity;
+	FIntRect viewRect;
+};
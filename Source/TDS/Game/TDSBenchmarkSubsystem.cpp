@@ -0,0 +1,229 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TDSBenchmarkSubsystem.h"
+#include "Engine/World.h"
+#include "Engine/GameInstance.h"
+#include "EngineUtils.h"
+#include "GameFramework/PlayerStart.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "HAL/PlatformMemory.h"
+#include "HAL/PlatformMisc.h"
+#include "RenderCore.h"
+
+#include "WeaponRegistrySubsystem.h"
+#include "../Character/TDSCharacter.h"
+#include "../Weapons/Projectiles/ProjectilePoolSubsystem.h"
+#include "../Weapons/Projectiles/ProjectileSimulationSubsystem.h"
+#include "../TDS.h"
+
+bool UTDSBenchmarkSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	FString scenarioName;
+	return Super::ShouldCreateSubsystem(Outer) && FParse::Value(FCommandLine::Get(), TEXT("TDSBenchmark="), scenarioName);
+}
+
+void UTDSBenchmarkSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	FString scenarioName;
+	FParse::Value(FCommandLine::Get(), TEXT("TDSBenchmark="), scenarioName);
+
+	const FTDSBenchmarkScenario* myScenario = scenarios.FindByPredicate([&scenarioName](const FTDSBenchmarkScenario& item)
+	{
+		return item.name == scenarioName;
+	});
+
+	if (!myScenario)
+	{
+		UE_LOG(LogTDS, Error, TEXT("UTDSBenchmarkSubsystem - no scenario %s in [/Script/TDS.TDSBenchmarkSubsystem]"), *scenarioName);
+		bIsFinished = true;
+		FPlatformMisc::RequestExitWithStatus(false, 2);
+		return;
+	}
+
+	scenario = *myScenario;
+}
+
+void UTDSBenchmarkSubsystem::Deinitialize()
+{
+	if (actorSpawnedHandle.IsValid())
+		GetWorld()->RemoveOnActorSpawnedHandler(actorSpawnedHandle);
+
+	characters.Empty();
+	samples.Empty();
+
+	Super::Deinitialize();
+}
+
+TStatId UTDSBenchmarkSubsystem::GetStatId() const
+{ RETURN_QUICK_DECLARE_CYCLE_STAT(UTDSBenchmarkSubsystem, STATGROUP_Tickables); }
+
+void UTDSBenchmarkSubsystem::Tick(float DeltaTime)
+{
+	if (bIsFinished || !GetWorld()->HasBegunPlay())
+		return;
+
+	if (!bIsStarted)
+	{
+		StartScenario();
+		return;
+	}
+
+	scenarioTime += DeltaTime;
+
+	if (scenarioTime < scenario.warmupTime)
+		return;
+
+	// Weapons had the warmup to stream in
+	if (!bIsFiring)
+	{
+		for (ATDSCharacter* myCharacter : characters)
+			if (IsValid(myCharacter))
+				myCharacter->AttackCharEvent(true);
+		bIsFiring = true;
+	}
+
+	RecordSample(DeltaTime);
+
+	if (scenarioTime >= scenario.warmupTime + scenario.duration)
+		FinishScenario();
+}
+
+void UTDSBenchmarkSubsystem::StartScenario()
+{
+	UWorld* world = GetWorld();
+	bIsStarted = true;
+
+	// Characters without the weapon would measure an idle world
+	UGameInstance* myGameInstance = world->GetGameInstance();
+	const UWeaponRegistrySubsystem* myRegistry = myGameInstance ? myGameInstance->GetSubsystem<UWeaponRegistrySubsystem>() : nullptr;
+	if (!myRegistry || !myRegistry->FindWeapon(scenario.weaponName).IsValid())
+	{
+		UE_LOG(LogTDS, Error, TEXT("UTDSBenchmarkSubsystem - %s: weapon %s not found in table"), *scenario.name, *scenario.weaponName.ToString());
+		bIsFinished = true;
+		FPlatformMisc::RequestExitWithStatus(false, 2);
+		return;
+	}
+
+	UClass* characterClass = scenario.characterClass.LoadSynchronous();
+	if (!characterClass)
+		characterClass = ATDSCharacter::StaticClass();
+
+	FVector origin = FVector::ZeroVector;
+	for (TActorIterator<APlayerStart> playerStart(world); playerStart; ++playerStart)
+	{
+		origin = playerStart->GetActorLocation();
+		break;
+	}
+
+	FActorSpawnParameters spawnParams;
+	spawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+	// Square grid around the player start, every character looks away from the center
+	const int32 gridSize = FMath::CeilToInt(FMath::Sqrt(static_cast<float>(scenario.characterCount)));
+	for (int32 i = 0; i < scenario.characterCount; ++i)
+	{
+		const FVector offset = FVector((i % gridSize) - (gridSize - 1) * 0.5f, (i / gridSize) - (gridSize - 1) * 0.5f, 0.f) * scenario.characterSpacing;
+		const FRotator rotation = offset.IsNearlyZero() ? FRotator::ZeroRotator : offset.Rotation();
+
+		ATDSCharacter* newCharacter = world->SpawnActor<ATDSCharacter>(characterClass, origin + offset, rotation, spawnParams);
+		if (!newCharacter)
+			continue;
+
+		newCharacter->SpawnDefaultController();
+		newCharacter->InitWeapon(scenario.weaponName);
+		characters.Add(newCharacter);
+	}
+
+	actorSpawnedHandle = world->AddOnActorSpawnedHandler(FOnActorSpawned::FDelegate::CreateUObject(this, &UTDSBenchmarkSubsystem::OnActorSpawned));
+
+	UE_LOG(LogTDS, Log, TEXT("UTDSBenchmarkSubsystem - %s: %d characters with %s"), *scenario.name, characters.Num(), *scenario.weaponName.ToString());
+}
+
+void UTDSBenchmarkSubsystem::RecordSample(float DeltaTime)
+{
+	UWorld* world = GetWorld();
+	const UProjectilePoolSubsystem* myPool = world->GetSubsystem<UProjectilePoolSubsystem>();
+	const UProjectileSimulationSubsystem* mySimulation = world->GetSubsystem<UProjectileSimulationSubsystem>();
+
+	FTDSBenchmarkSample& newSample = samples.AddDefaulted_GetRef();
+	newSample.frame = GFrameCounter;
+	newSample.time = scenarioTime - scenario.warmupTime;
+	newSample.deltaMs = DeltaTime * 1000.f;
+	newSample.gameThreadMs = FPlatformTime::ToMilliseconds(GGameThreadTime);
+	newSample.pooledProjectiles = myPool ? myPool->GetTotalPoolStats().active : 0;
+	newSample.simulatedProjectiles = mySimulation ? mySimulation->GetNumProjectiles() : 0;
+	newSample.spawnedActors = spawnedActors;
+	newSample.destroyedActors = destroyedActors;
+	newSample.usedMemoryMB = FPlatformMemory::GetStats().UsedPhysical / (1024.f * 1024.f);
+}
+
+void UTDSBenchmarkSubsystem::FinishScenario()
+{
+	bIsFinished = true;
+
+	for (ATDSCharacter* myCharacter : characters)
+		if (IsValid(myCharacter))
+			myCharacter->AttackCharEvent(false);
+
+	float averageGameThreadMs = 0.f;
+	for (const FTDSBenchmarkSample& sample : samples)
+		averageGameThreadMs += sample.gameThreadMs;
+	averageGameThreadMs /= FMath::Max(samples.Num(), 1);
+
+	const float memoryGrowthMB = samples.Num() > 0 ? samples.Last().usedMemoryMB - samples[0].usedMemoryMB : 0.f;
+
+	bool bIsPassed = true;
+	if (scenario.maxGameThreadMs > 0.f && averageGameThreadMs > scenario.maxGameThreadMs)
+	{
+		UE_LOG(LogTDS, Error, TEXT("UTDSBenchmarkSubsystem - %s: game thread %.2f ms over %.2f ms"), *scenario.name, averageGameThreadMs, scenario.maxGameThreadMs);
+		bIsPassed = false;
+	}
+	if (scenario.maxMemoryGrowthMB > 0.f && memoryGrowthMB > scenario.maxMemoryGrowthMB)
+	{
+		UE_LOG(LogTDS, Error, TEXT("UTDSBenchmarkSubsystem - %s: memory grew %.1f MB, over %.1f MB"), *scenario.name, memoryGrowthMB, scenario.maxMemoryGrowthMB);
+		bIsPassed = false;
+	}
+
+	WriteResults(bIsPassed, averageGameThreadMs, memoryGrowthMB);
+
+	UE_LOG(LogTDS, Log, TEXT("UTDSBenchmarkSubsystem - %s %s: %d frames, game thread %.2f ms, memory growth %.1f MB"),
+		*scenario.name, bIsPassed ? TEXT("passed") : TEXT("failed"), samples.Num(), averageGameThreadMs, memoryGrowthMB);
+
+	FPlatformMisc::RequestExitWithStatus(false, bIsPassed ? 0 : 1);
+}
+
+void UTDSBenchmarkSubsystem::WriteResults(bool bIsPassed, float averageGameThreadMs, float memoryGrowthMB) const
+{
+	const FString benchmarkDir = FPaths::ProjectSavedDir() / TEXT("Benchmarks");
+
+	FString csv = TEXT("Frame,Time,DeltaMs,GameThreadMs,PooledProjectiles,SimulatedProjectiles,SpawnedActors,DestroyedActors,UsedMemoryMB\n");
+	for (const FTDSBenchmarkSample& sample : samples)
+		csv += FString::Printf(TEXT("%llu,%.4f,%.3f,%.3f,%d,%d,%d,%d,%.1f\n"), sample.frame, sample.time, sample.deltaMs, sample.gameThreadMs,
+			sample.pooledProjectiles, sample.simulatedProjectiles, sample.spawnedActors, sample.destroyedActors, sample.usedMemoryMB);
+
+	FFileHelper::SaveStringToFile(csv, *(benchmarkDir / scenario.name + TEXT(".csv")));
+
+	// One line per run, so runs of one scenario can be compared
+	const FString summaryFile = benchmarkDir / TEXT("Summary.csv");
+	const bool bHasSummary = FPaths::FileExists(summaryFile);
+
+	FString summary = bHasSummary ? FString() : TEXT("Date,Scenario,Frames,AverageGameThreadMs,MemoryGrowthMB,Passed\n");
+	summary += FString::Printf(TEXT("%s,%s,%d,%.3f,%.1f,%d\n"), *FDateTime::Now().ToString(), *scenario.name, samples.Num(),
+		averageGameThreadMs, memoryGrowthMB, bIsPassed ? 1 : 0);
+
+	FFileHelper::SaveStringToFile(summary, *summaryFile, FFileHelper::EEncodingOptions::AutoDetect, &IFileManager::Get(), FILEWRITE_Append);
+}
+
+void UTDSBenchmarkSubsystem::OnActorSpawned(AActor* actor)
+{
+	spawnedActors++;
+	actor->OnDestroyed.AddDynamic(this, &UTDSBenchmarkSubsystem::OnActorDestroyed);
+}
+
+void UTDSBenchmarkSubsystem::OnActorDestroyed(AActor* actor)
+{ destroyedActors++; }
@@ -0,0 +1,98 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "TDSTickableWorldSubsystem.h"
+#include "TDSBenchmarkSubsystem.generated.h"
+
+class ATDSCharacter;
+
+USTRUCT()
+struct FTDSBenchmarkScenario
+{
+	GENERATED_BODY()
+
+	UPROPERTY(Config)
+	FString name;
+	UPROPERTY(Config)
+	TSoftClassPtr<ATDSCharacter> characterClass;
+	// Row of the weapon table
+	UPROPERTY(Config)
+	FName weaponName;
+	UPROPERTY(Config)
+	int32 characterCount = 50;
+	UPROPERTY(Config)
+	float characterSpacing = 300.f;
+	// Weapons are streamed in and pools are filled, nothing is recorded
+	UPROPERTY(Config)
+	float warmupTime = 5.f;
+	UPROPERTY(Config)
+	float duration = 30.f;
+
+	// ============================ Regression gates (0 = off) ============================
+	UPROPERTY(Config)
+	float maxGameThreadMs = 0.f;
+	UPROPERTY(Config)
+	float maxMemoryGrowthMB = 0.f;
+};
+
+struct FTDSBenchmarkSample
+{
+	uint64 frame = 0;
+	float time = 0.f;
+	float deltaMs = 0.f;
+	float gameThreadMs = 0.f;
+	int32 pooledProjectiles = 0;
+	int32 simulatedProjectiles = 0;
+	int32 spawnedActors = 0;
+	int32 destroyedActors = 0;
+	float usedMemoryMB = 0.f;
+};
+
+// Headless benchmark: with -TDSBenchmark=<scenario> the world spawns armed characters, keeps them firing
+// and records one sample per frame. Samples go to Saved/Benchmarks/<scenario>.csv, the game exits with 1 if a gate fails.
+// UE4Editor TDS /Game/Maps/TopDownExampleMap -game -nullrhi -unattended -TDSBenchmark=AssaultRifles50
+UCLASS(Config = Game)
+class TDS_API UTDSBenchmarkSubsystem : public UTDSTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	UPROPERTY(Config)
+	TArray<FTDSBenchmarkScenario> scenarios;
+
+private:
+	void StartScenario();
+	void RecordSample(float DeltaTime);
+	void FinishScenario();
+	void WriteResults(bool bIsPassed, float averageGameThreadMs, float memoryGrowthMB) const;
+
+	// Actors spawned during the scenario report their own destruction
+	void OnActorSpawned(AActor* actor);
+	UFUNCTION()
+	void OnActorDestroyed(AActor* actor);
+
+	FTDSBenchmarkScenario scenario;
+	bool bIsStarted = false;
+	bool bIsFinished = false;
+	float scenarioTime = 0.f;
+	bool bIsFiring = false;
+
+	UPROPERTY()
+	TArray<ATDSCharacter*> characters;
+
+	FDelegateHandle actorSpawnedHandle;
+	int32 spawnedActors = 0;
+	int32 destroyedActors = 0;
+
+	TArray<FTDSBenchmarkSample> samples;
+};
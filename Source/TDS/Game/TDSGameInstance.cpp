@@ -2,15 +2,16 @@
 
 
 #include "TDSGameInstance.h"
+#include "WeaponRegistrySubsystem.h"
 
 bool UTDSGameInstance::GetWeaponInfoByName(FName nameWeapon, FWeaponInfo& outInfoWeapon)
 {
 	bool bIsFind = false;
-	FWeaponInfo* weaponInfoRow = nullptr;
+	UWeaponRegistrySubsystem* myRegistry = GetSubsystem<UWeaponRegistrySubsystem>();
 
-	if (weaponInfoTable)
+	if (myRegistry)
 	{
-		weaponInfoRow = weaponInfoTable->FindRow<FWeaponInfo>(nameWeapon, "", false);
+		const FWeaponInfo* weaponInfoRow = myRegistry->GetWeaponInfo(myRegistry->FindWeapon(nameWeapon));
 		if (weaponInfoRow)
 		{
 			bIsFind = true;
@@ -19,6 +19,7 @@ public:
 	// table
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WeaponSettings")
 	UDataTable* weaponInfoTable = nullptr;
+	// Copies the row, native code should use the weapon registry handles
 	UFUNCTION(BlueprintCallable)
 	bool GetWeaponInfoByName(FName nameWeapon, FWeaponInfo& outInfoWeapon);
 };
@@ -0,0 +1,32 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TDSTickableWorldSubsystem.h"
+#include "Engine/World.h"
+
+bool UTDSTickableWorldSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	UWorld* world = Cast<UWorld>(Outer);
+	return world && world->IsGameWorld();
+}
+
+void UTDSTickableWorldSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+	bIsInitialized = true;
+}
+
+void UTDSTickableWorldSubsystem::Deinitialize()
+{
+	bIsInitialized = false;
+	Super::Deinitialize();
+}
+
+ETickableTickType UTDSTickableWorldSubsystem::GetTickableTickType() const
+{ return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional; }
+
+bool UTDSTickableWorldSubsystem::IsTickable() const
+{ return bIsInitialized && !IsTemplate(); }
+
+UWorld* UTDSTickableWorldSubsystem::GetTickableGameObjectWorld() const
+{ return GetWorld(); }
@@ -0,0 +1,157 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WeaponRegistrySubsystem.h"
+
+#include "TDSGameInstance.h"
+#include "../TDS.h"
+
+void UWeaponRegistrySubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	UTDSGameInstance* myGameInstance = Cast<UTDSGameInstance>(GetGameInstance());
+	weaponTable = myGameInstance ? myGameInstance->weaponInfoTable : nullptr;
+
+	if (weaponTable)
+	{
+#if WITH_EDITOR
+		// Row pointers don't survive a reimport of the table
+		weaponTable->OnDataTableChanged().AddUObject(this, &UWeaponRegistrySubsystem::BuildRegistry);
+#endif
+	}
+
+	BuildRegistry();
+	PreloadWeaponSet(defaultPreloadWeapons);
+}
+
+void UWeaponRegistrySubsystem::Deinitialize()
+{
+#if WITH_EDITOR
+	if (weaponTable)
+		weaponTable->OnDataTableChanged().RemoveAll(this);
+#endif
+
+	for (auto& assetHandle : weaponAssetHandles)
+		if (assetHandle.Value.IsValid())
+			assetHandle.Value->ReleaseHandle();
+	weaponAssetHandles.Empty();
+
+	weaponDefinitions.Empty();
+	weaponNames.Empty();
+	dispersionTables.Empty();
+	handleByName.Empty();
+	weaponTable = nullptr;
+
+	Super::Deinitialize();
+}
+
+void UWeaponRegistrySubsystem::BuildRegistry()
+{
+	weaponDefinitions.Reset();
+	weaponNames.Reset();
+	dispersionTables.Reset();
+	handleByName.Reset();
+
+	if (!weaponTable)
+		return;
+
+	if (!weaponTable->GetRowStruct() || !weaponTable->GetRowStruct()->IsChildOf(FWeaponInfo::StaticStruct()))
+	{
+		UE_LOG(LogTDS, Error, TEXT("UWeaponRegistrySubsystem::BuildRegistry - %s rows are not FWeaponInfo"), *weaponTable->GetName());
+		return;
+	}
+
+	for (const auto& row : weaponTable->GetRowMap())
+	{
+		FWeaponHandle newHandle;
+		newHandle.index = weaponDefinitions.Add(reinterpret_cast<const FWeaponInfo*>(row.Value));
+		weaponNames.Add(row.Key);
+		BuildDispersionTable(row.Key, dispersionTables.AddDefaulted_GetRef());
+		handleByName.Add(row.Key, newHandle);
+	}
+}
+
+void UWeaponRegistrySubsystem::BuildDispersionTable(FName nameWeapon, TArray<FVector2D>& outSamples) const
+{
+	const int32 numSamples = FMath::RoundUpToPowerOfTwo(FMath::Max(dispersionTableSize, 1));
+
+	// Name hash of FName differs between processes, the string CRC does not
+	FRandomStream randomStream(FCrc::StrCrc32(*nameWeapon.ToString()));
+
+	outSamples.SetNumUninitialized(numSamples);
+	for (FVector2D& sample : outSamples)
+	{
+		// Uniform over the disk, not crowded in the center
+		const float radius = FMath::Sqrt(randomStream.GetFraction());
+		const float angle = randomStream.GetFraction() * 2.f * PI;
+		sample = FVector2D(FMath::Cos(angle), FMath::Sin(angle)) * radius;
+	}
+}
+
+FWeaponHandle UWeaponRegistrySubsystem::FindWeapon(FName nameWeapon) const
+{
+	const FWeaponHandle* weaponHandle = handleByName.Find(nameWeapon);
+	return weaponHandle ? *weaponHandle : FWeaponHandle();
+}
+
+FName UWeaponRegistrySubsystem::GetWeaponName(FWeaponHandle weaponHandle) const
+{ return weaponNames.IsValidIndex(weaponHandle.index) ? weaponNames[weaponHandle.index] : NAME_None; }
+
+int32 UWeaponRegistrySubsystem::GetNumWeapons() const
+{ return weaponDefinitions.Num(); }
+
+const FWeaponInfo* UWeaponRegistrySubsystem::GetWeaponInfo(FWeaponHandle weaponHandle) const
+{ return weaponDefinitions.IsValidIndex(weaponHandle.index) ? weaponDefinitions[weaponHandle.index] : nullptr; }
+
+const TArray<FVector2D>* UWeaponRegistrySubsystem::GetDispersionTable(FWeaponHandle weaponHandle) const
+{ return dispersionTables.IsValidIndex(weaponHandle.index) ? &dispersionTables[weaponHandle.index] : nullptr; }
+
+// ============================= Asset streaming =============================
+void UWeaponRegistrySubsystem::RequestWeaponAssets(FWeaponHandle weaponHandle, FStreamableDelegate onAssetsLoaded)
+{
+	const FWeaponInfo* myWeaponInfo = GetWeaponInfo(weaponHandle);
+
+	if (!myWeaponInfo || AreWeaponAssetsLoaded(weaponHandle))
+	{
+		onAssetsLoaded.ExecuteIfBound();
+		return;
+	}
+
+	TArray<FSoftObjectPath> assetPaths;
+	myWeaponInfo->GetSoftAssetPaths(assetPaths);
+
+	if (assetPaths.Num() == 0)
+	{
+		onAssetsLoaded.ExecuteIfBound();
+		return;
+	}
+
+	// A load already in flight keeps going, the newest handle holds the same assets
+	weaponAssetHandles.Add(weaponHandle.index, streamableManager.RequestAsyncLoad(assetPaths, onAssetsLoaded));
+}
+
+bool UWeaponRegistrySubsystem::AreWeaponAssetsLoaded(FWeaponHandle weaponHandle) const
+{
+	const TSharedPtr<FStreamableHandle>* assetHandle = weaponAssetHandles.Find(weaponHandle.index);
+	return assetHandle && assetHandle->IsValid() && (*assetHandle)->HasLoadCompleted();
+}
+
+void UWeaponRegistrySubsystem::PreloadWeaponSet(const TArray<FName>& weaponSet)
+{
+	for (const FName& nameWeapon : weaponSet)
+	{
+		const FWeaponHandle weaponHandle = FindWeapon(nameWeapon);
+		if (weaponHandle.IsValid())
+			RequestWeaponAssets(weaponHandle);
+		else
+			UE_LOG(LogTDS, Warning, TEXT("UWeaponRegistrySubsystem::PreloadWeaponSet - %s not found in table"), *nameWeapon.ToString());
+	}
+}
+
+void UWeaponRegistrySubsystem::ReleaseWeaponAssets(FWeaponHandle weaponHandle)
+{
+	TSharedPtr<FStreamableHandle> assetHandle;
+	if (weaponAssetHandles.RemoveAndCopyValue(weaponHandle.index, assetHandle) && assetHandle.IsValid())
+		assetHandle->ReleaseHandle();
+}
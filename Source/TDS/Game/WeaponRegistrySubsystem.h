@@ -0,0 +1,74 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "Engine/DataTable.h"
+#include "Engine/StreamableManager.h"
+
+#include "../FuncLibrary/Types.h"
+#include "WeaponRegistrySubsystem.generated.h"
+
+// Weapon table of the game instance turned once into immutable definitions addressed by FWeaponHandle.
+// Weapon assets are soft references and are streamed in here when a weapon is requested or preloaded
+UCLASS(Config = Game)
+class TDS_API UWeaponRegistrySubsystem : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	UFUNCTION(BlueprintCallable)
+	FWeaponHandle FindWeapon(FName nameWeapon) const;
+	UFUNCTION(BlueprintCallable)
+	FName GetWeaponName(FWeaponHandle weaponHandle) const;
+	UFUNCTION(BlueprintCallable)
+	int32 GetNumWeapons() const;
+
+	// Points into the table row, valid until the table is reimported in the editor. Keep the handle, not the pointer
+	const FWeaponInfo* GetWeaponInfo(FWeaponHandle weaponHandle) const;
+
+	// ================================ Dispersion ================================
+	// Samples per weapon, a power of two so the shot counter wraps with a mask
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "Dispersion")
+	int32 dispersionTableSize = 256;
+
+	// Points in the unit disk, the same on every machine for the same weapon name. Shot i uses sample (seed + i).
+	// Rebuilt with the registry like GetWeaponInfo
+	const TArray<FVector2D>* GetDispersionTable(FWeaponHandle weaponHandle) const;
+
+	// ============================= Asset streaming =============================
+	// Weapons loaded when the game starts
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "Streaming")
+	TArray<FName> defaultPreloadWeapons;
+
+	// Loads the weapon assets in the background and keeps them resident, calls back when they are in memory
+	void RequestWeaponAssets(FWeaponHandle weaponHandle, FStreamableDelegate onAssetsLoaded = FStreamableDelegate());
+	UFUNCTION(BlueprintCallable)
+	bool AreWeaponAssetsLoaded(FWeaponHandle weaponHandle) const;
+
+	// Expected loadout of the level, so there is no load on the first use
+	UFUNCTION(BlueprintCallable)
+	void PreloadWeaponSet(const TArray<FName>& weaponSet);
+	// Assets of the weapon can be garbage collected after this
+	UFUNCTION(BlueprintCallable)
+	void ReleaseWeaponAssets(FWeaponHandle weaponHandle);
+
+private:
+	void BuildRegistry();
+	void BuildDispersionTable(FName nameWeapon, TArray<FVector2D>& outSamples) const;
+
+	FStreamableManager streamableManager;
+	TMap<int32, TSharedPtr<FStreamableHandle>> weaponAssetHandles;
+
+	UPROPERTY()
+	UDataTable* weaponTable = nullptr;
+
+	TArray<const FWeaponInfo*> weaponDefinitions;
+	TArray<FName> weaponNames;
+	TArray<TArray<FVector2D>> dispersionTables;
+	TMap<FName, FWeaponHandle> handleByName;
+};
@@ -0,0 +1,128 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CoreMinimal.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "HAL/PlatformMisc.h"
+#include "Misc/App.h"
+
+#include "WeaponSimulation.h"
+#include "StaminaSimulation.h"
+#include "../TDS.h"
+
+// tds.Benchmark.Simulation [ticks] [weapons] [deltaTime] [rateOfFire]
+// Runs the weapon and stamina rules alone, without a world: -nullrhi -ExecCmds="tds.Benchmark.Simulation 1000000".
+// Fire rate and stamina cycles are checked against the config, an unattended run exits with 1 on a mismatch
+namespace
+{
+	void RunSimulationBenchmark(const TArray<FString>& args)
+	{
+		const int32 numTicks = args.IsValidIndex(0) ? FCString::Atoi(*args[0]) : 1000000;
+		const int32 numWeapons = args.IsValidIndex(1) ? FMath::Max(FCString::Atoi(*args[1]), 1) : 100;
+		const float DeltaTime = args.IsValidIndex(2) ? FCString::Atof(*args[2]) : 1.f / 60.f;
+		const float rateOfFire = args.IsValidIndex(3) ? FCString::Atof(*args[3]) : 0.1f;
+
+		// ================================ Weapons ================================
+		FWeaponSimConfig weaponConfig;
+		weaponConfig.fireInterval = FMath::Max(rateOfFire, KINDA_SMALL_NUMBER);
+		weaponConfig.reloadTime = 2.f;
+		weaponConfig.maxRound = 30;
+
+		TArray<FWeaponSimState> weapons;
+		weapons.SetNum(numWeapons);
+		for (FWeaponSimState& weapon : weapons)
+		{
+			weapon.round = weaponConfig.maxRound;
+			TDSSimulation::SetTriggerHeld(weapon, true);
+		}
+
+		const int32 ticksPerWeapon = FMath::Max(numTicks / numWeapons, 1);
+		int64 numShots = 0;
+		int64 numReloads = 0;
+
+		const double weaponStart = FPlatformTime::Seconds();
+		for (int32 tick = 0; tick < ticksPerWeapon; ++tick)
+			for (FWeaponSimState& weapon : weapons)
+			{
+				const FWeaponSimStep step = TDSSimulation::StepWeapon(weapon, weaponConfig, DeltaTime);
+				numShots += step.numShots;
+				numReloads += step.bIsReloadFinished ? 1 : 0;
+			}
+		const double weaponSeconds = FPlatformTime::Seconds() - weaponStart;
+
+		// Full magazine, then a reload, again and again
+		const double simulatedSeconds = ticksPerWeapon * static_cast<double>(DeltaTime);
+		const double cycleSeconds = weaponConfig.maxRound * weaponConfig.fireInterval + weaponConfig.reloadTime;
+		const double expectedShotsPerSecond = weaponConfig.maxRound / cycleSeconds;
+		const double shotsPerSecond = numShots / (simulatedSeconds * numWeapons);
+
+		UE_LOG(LogTDS, Log, TEXT("Weapon simulation: %d weapons x %d ticks in %.2f ms (%.1f ns per tick), %lld shots, %lld reloads"),
+			numWeapons, ticksPerWeapon, weaponSeconds * 1000.0, weaponSeconds * 1e9 / (static_cast<double>(ticksPerWeapon) * numWeapons), numShots, numReloads);
+		UE_LOG(LogTDS, Log, TEXT("Weapon simulation: %.3f rounds per second per weapon, expected %.3f at rateOfFire %.3f"),
+			shotsPerSecond, expectedShotsPerSecond, weaponConfig.fireInterval);
+
+		bool bIsPassed = true;
+
+		// The last cycle may be cut anywhere, a frame may be late on every shot
+		const double shotsTolerance = expectedShotsPerSecond * 0.02 + (weaponConfig.maxRound + 1) / simulatedSeconds;
+		if (FMath::Abs(shotsPerSecond - expectedShotsPerSecond) > shotsTolerance)
+		{
+			UE_LOG(LogTDS, Error, TEXT("Weapon simulation: %.3f rounds per second, expected %.3f +- %.3f"), shotsPerSecond, expectedShotsPerSecond, shotsTolerance);
+			bIsPassed = false;
+		}
+
+		// ================================ Stamina ================================
+		// Sprint until exhausted, sprint again once recovered. Stamina is only touched at its events
+		FStaminaSimConfig staminaConfig;
+		FStaminaSimState stamina;
+		stamina.stamina = staminaConfig.maxStamina;
+		TDSSimulation::SetStaminaDraining(stamina, staminaConfig, true, 0.f);
+
+		const float staminaDuration = numTicks * DeltaTime;
+		int32 numExhausted = 0;
+		int32 numRecovered = 0;
+		int32 numEvents = 0;
+
+		const double staminaStart = FPlatformTime::Seconds();
+		for (float eventTime = TDSSimulation::GetNextStaminaEventTime(stamina, staminaConfig);
+			eventTime >= 0.f && eventTime <= staminaDuration && numEvents < numTicks;
+			eventTime = TDSSimulation::GetNextStaminaEventTime(stamina, staminaConfig))
+		{
+			const FStaminaSimStep step = TDSSimulation::UpdateStamina(stamina, staminaConfig, eventTime);
+			numEvents++;
+
+			if (step.bIsExhausted)
+				numExhausted++;
+			if (step.bIsRecovered)
+			{
+				numRecovered++;
+				TDSSimulation::SetStaminaDraining(stamina, staminaConfig, true, eventTime);
+			}
+		}
+		const double staminaSeconds = FPlatformTime::Seconds() - staminaStart;
+
+		UE_LOG(LogTDS, Log, TEXT("Stamina simulation: %.0f s in %d events, %.3f ms, exhausted %d times"),
+			staminaDuration, numEvents, staminaSeconds * 1000.0, numExhausted);
+
+		// Full stamina runs out once, then every cycle is the delay after zero, the way back to recoveryFromTired and its sprint
+		const double firstExhaustTime = staminaConfig.maxStamina / staminaConfig.decreaseStamina;
+		const double staminaCycle = staminaConfig.timeToRecoverStaminaAfterZero
+			+ staminaConfig.recoveryFromTired / staminaConfig.increaseStamina + staminaConfig.recoveryFromTired / staminaConfig.decreaseStamina;
+		const int32 expectedExhausted = staminaDuration < firstExhaustTime ? 0 : 1 + FMath::FloorToInt((staminaDuration - firstExhaustTime) / staminaCycle);
+
+		// A threshold right at the end may fall on either side
+		if (FMath::Abs(numExhausted - expectedExhausted) > 1 || numRecovered < numExhausted - 1 || numRecovered > numExhausted)
+		{
+			UE_LOG(LogTDS, Error, TEXT("Stamina simulation: exhausted %d times, expected %d, recovered %d times"), numExhausted, expectedExhausted, numRecovered);
+			bIsPassed = false;
+		}
+
+		if (!bIsPassed && FApp::IsUnattended())
+			FPlatformMisc::RequestExitWithStatus(false, 1);
+	}
+
+	FAutoConsoleCommand simulationBenchmarkCommand(
+		TEXT("tds.Benchmark.Simulation"),
+		TEXT("Runs the weapon and stamina simulation. Args: [ticks] [weapons] [deltaTime] [rateOfFire]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&RunSimulationBenchmark));
+}
@@ -0,0 +1,96 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "StaminaSimulation.h"
+
+float TDSSimulation::GetStamina(const FStaminaSimState& stamina, const FStaminaSimConfig& config, float time)
+{
+	if (stamina.bIsDraining)
+		return FMath::Max(stamina.stamina - config.decreaseStamina * FMath::Max(time - stamina.changeTime, 0.f), 0.f);
+
+	return FMath::Min(stamina.stamina + config.increaseStamina * FMath::Max(time - stamina.recoverStartTime, 0.f), config.maxStamina);
+}
+
+bool TDSSimulation::IsStaminaTired(const FStaminaSimState& stamina, const FStaminaSimConfig& config, float time)
+{
+	if (stamina.bIsDraining)
+		return stamina.bIsTired || GetStamina(stamina, config, time) <= 0.f;
+
+	return stamina.bIsTired && GetStamina(stamina, config, time) < config.recoveryFromTired;
+}
+
+FStaminaSimStep TDSSimulation::UpdateStamina(FStaminaSimState& stamina, const FStaminaSimConfig& config, float time)
+{
+	FStaminaSimStep step;
+
+	if (stamina.bIsDraining)
+	{
+		if (config.decreaseStamina <= 0.f)
+			return step;
+
+		// Sprint stops at zero, the longer delay starts from there
+		const float exhaustTime = stamina.changeTime + stamina.stamina / config.decreaseStamina;
+		if (time < exhaustTime)
+			return step;
+
+		stamina.stamina = 0.f;
+		stamina.changeTime = exhaustTime;
+		stamina.bIsDraining = false;
+		stamina.recoverStartTime = exhaustTime + config.timeToRecoverStaminaAfterZero;
+		stamina.bIsTired = true;
+		step.bIsExhausted = true;
+	}
+
+	// Event times are computed from the same values, the tolerance keeps a threshold from being missed by rounding
+	float currentStamina = GetStamina(stamina, config, time);
+	if (currentStamina >= config.maxStamina - KINDA_SMALL_NUMBER)
+		currentStamina = config.maxStamina;
+
+	if (stamina.bIsTired && currentStamina >= config.recoveryFromTired - KINDA_SMALL_NUMBER)
+	{
+		stamina.bIsTired = false;
+		step.bIsRecovered = true;
+	}
+
+	if (currentStamina >= config.maxStamina && stamina.stamina < config.maxStamina)
+		step.bIsFull = true;
+
+	// Rate goes on from the folded value
+	if (step.bIsRecovered || step.bIsFull)
+	{
+		stamina.stamina = currentStamina;
+		stamina.changeTime = time;
+		stamina.recoverStartTime = time;
+	}
+
+	return step;
+}
+
+FStaminaSimStep TDSSimulation::SetStaminaDraining(FStaminaSimState& stamina, const FStaminaSimConfig& config, bool bIsDraining, float time)
+{
+	FStaminaSimStep step = UpdateStamina(stamina, config, time);
+
+	if (stamina.bIsDraining == bIsDraining || (bIsDraining && stamina.bIsTired))
+		return step;
+
+	stamina.stamina = GetStamina(stamina, config, time);
+	stamina.changeTime = time;
+	stamina.bIsDraining = bIsDraining;
+
+	if (!bIsDraining)
+		stamina.recoverStartTime = time + config.timeToRecoverStamina;
+
+	return step;
+}
+
+float TDSSimulation::GetNextStaminaEventTime(const FStaminaSimState& stamina, const FStaminaSimConfig& config)
+{
+	if (stamina.bIsDraining)
+		return config.decreaseStamina > 0.f ? stamina.changeTime + stamina.stamina / config.decreaseStamina : -1.f;
+
+	if (config.increaseStamina <= 0.f || stamina.stamina >= config.maxStamina)
+		return -1.f;
+
+	const float nextThreshold = stamina.bIsTired ? FMath::Min(config.recoveryFromTired, config.maxStamina) : config.maxStamina;
+	return stamina.recoverStartTime + FMath::Max(nextThreshold - stamina.stamina, 0.f) / config.increaseStamina;
+}
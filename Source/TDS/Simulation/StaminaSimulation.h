@@ -0,0 +1,57 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Stamina rules of the character without actors or the timer manager.
+// Stamina changes at a constant rate between two events, so only the last change is stored
+// and the value at any time is computed from it
+
+struct FStaminaSimConfig
+{
+	float maxStamina = 100.f;
+	// Per second
+	float decreaseStamina = 1.f;
+	float increaseStamina = 1.f;
+	// Tired character can sprint again from this stamina
+	float recoveryFromTired = 40.f;
+	// Delay before the stamina starts to come back
+	float timeToRecoverStamina = 0.5f;
+	float timeToRecoverStaminaAfterZero = 2.f;
+};
+
+struct FStaminaSimState
+{
+	// Stamina at changeTime
+	float stamina = 100.f;
+	float changeTime = 0.f;
+	bool bIsDraining = false;
+	// Not draining, stamina comes back from this time on
+	float recoverStartTime = 0.f;
+	// Ran out, no sprint until the stamina is back over recoveryFromTired
+	bool bIsTired = false;
+};
+
+struct FStaminaSimStep
+{
+	// Stamina is over, the sprint has to stop
+	bool bIsExhausted = false;
+	// Stamina came back over recoveryFromTired, the sprint may go on
+	bool bIsRecovered = false;
+	bool bIsFull = false;
+};
+
+namespace TDSSimulation
+{
+	float GetStamina(const FStaminaSimState& stamina, const FStaminaSimConfig& config, float time);
+	bool IsStaminaTired(const FStaminaSimState& stamina, const FStaminaSimConfig& config, float time);
+
+	// Folds the thresholds crossed before the time into the state
+	FStaminaSimStep UpdateStamina(FStaminaSimState& stamina, const FStaminaSimConfig& config, float time);
+	// Sprinting and moving, every stop restarts the recovery delay
+	FStaminaSimStep SetStaminaDraining(FStaminaSimState& stamina, const FStaminaSimConfig& config, bool bIsDraining, float time);
+
+	// Time of the next threshold (empty, recovered from tired, full), negative if the stamina does not change any more
+	float GetNextStaminaEventTime(const FStaminaSimState& stamina, const FStaminaSimConfig& config);
+}
@@ -0,0 +1,106 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WeaponSimulation.h"
+
+namespace
+{
+	// State after firing or reloading is over
+	EWeaponSimState GetReadyState(const FWeaponSimState& weapon)
+	{
+		if (weapon.bIsTriggerHeld)
+			return EWeaponSimState::FIRING_STATE;
+
+		return weapon.fireTimer > 0.f ? EWeaponSimState::COOLDOWN_STATE : EWeaponSimState::IDLE_STATE;
+	}
+}
+
+FWeaponSimStep TDSSimulation::StepWeapon(FWeaponSimState& weapon, const FWeaponSimConfig& config, float DeltaTime)
+{
+	FWeaponSimStep step;
+
+	switch (weapon.state)
+	{
+	case EWeaponSimState::FIRING_STATE:
+	{
+		const bool bIsWeaponReady = weapon.fireTimer <= 0.f;
+		weapon.fireTimer -= DeltaTime;
+
+		if (weapon.round <= 0)
+		{
+			weapon.fireTimer = FMath::Max(weapon.fireTimer, 0.f);
+			step.bIsReloadStarted = StartReload(weapon, config);
+			break;
+		}
+
+		if (weapon.fireTimer > 0.f)
+			break;
+
+		// Trigger pulled on a ready weapon, the first round goes now and not at the start of the frame
+		if (bIsWeaponReady)
+			weapon.fireTimer = 0.f;
+
+		step.firstShotOffset = FMath::Min(-weapon.fireTimer, DeltaTime);
+
+		// Every shot which was due during this step
+		while (weapon.fireTimer <= 0.f && weapon.round > 0)
+		{
+			step.numShots++;
+			weapon.round--;
+			weapon.fireTimer += config.fireInterval;
+		}
+		break;
+	}
+	case EWeaponSimState::COOLDOWN_STATE:
+		weapon.fireTimer -= DeltaTime;
+		if (weapon.fireTimer <= 0.f)
+			FinishCooldown(weapon);
+		break;
+	case EWeaponSimState::RELOADING_STATE:
+		weapon.fireTimer = FMath::Max(weapon.fireTimer - DeltaTime, 0.f);
+		weapon.reloadTimer -= DeltaTime;
+		if (weapon.reloadTimer <= 0.f)
+		{
+			FinishReload(weapon, config);
+			step.bIsReloadFinished = true;
+		}
+		break;
+	default:
+		break;
+	}
+
+	return step;
+}
+
+void TDSSimulation::SetTriggerHeld(FWeaponSimState& weapon, bool bIsTriggerHeld)
+{
+	weapon.bIsTriggerHeld = bIsTriggerHeld;
+
+	// Reloading goes on, the trigger is checked when it is over
+	if (weapon.state != EWeaponSimState::RELOADING_STATE)
+		weapon.state = GetReadyState(weapon);
+}
+
+bool TDSSimulation::StartReload(FWeaponSimState& weapon, const FWeaponSimConfig& config)
+{
+	if (weapon.state == EWeaponSimState::RELOADING_STATE)
+		return false;
+
+	weapon.reloadTimer = config.reloadTime;
+	weapon.state = EWeaponSimState::RELOADING_STATE;
+	return true;
+}
+
+void TDSSimulation::FinishReload(FWeaponSimState& weapon, const FWeaponSimConfig& config)
+{
+	weapon.reloadTimer = 0.f;
+	weapon.round = config.maxRound;
+	weapon.state = GetReadyState(weapon);
+}
+
+void TDSSimulation::FinishCooldown(FWeaponSimState& weapon)
+{
+	// Time spent not firing is not a debt of shots
+	weapon.fireTimer = 0.f;
+	weapon.state = GetReadyState(weapon);
+}
@@ -0,0 +1,58 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Fire and reload rules of a weapon without actors, timers or UObjects.
+// UWeaponTickSubsystem runs them for the weapons of the world, the benchmark runs them alone
+
+// Same order as EWeaponState
+enum class EWeaponSimState : uint8
+{
+	IDLE_STATE,
+	FIRING_STATE,
+	COOLDOWN_STATE,
+	RELOADING_STATE
+};
+
+struct FWeaponSimConfig
+{
+	float fireInterval = 0.5f;
+	float reloadTime = 2.f;
+	int32 maxRound = 10;
+};
+
+struct FWeaponSimState
+{
+	EWeaponSimState state = EWeaponSimState::IDLE_STATE;
+	bool bIsTriggerHeld = false;
+	float fireTimer = 0.f;
+	float reloadTimer = 0.f;
+	int32 round = 0;
+};
+
+// What happened to the weapon during one step
+struct FWeaponSimStep
+{
+	// Shots which were due, the first one firstShotOffset seconds before the end of the step, then every fireInterval
+	int32 numShots = 0;
+	float firstShotOffset = 0.f;
+	bool bIsReloadStarted = false;
+	bool bIsReloadFinished = false;
+};
+
+namespace TDSSimulation
+{
+	// Advances the timers of the current state, the state only changes through the transitions below
+	FWeaponSimStep StepWeapon(FWeaponSimState& weapon, const FWeaponSimConfig& config, float DeltaTime);
+
+	// ================================= Transitions =================================
+	void SetTriggerHeld(FWeaponSimState& weapon, bool bIsTriggerHeld);
+	// False if the weapon is already reloading
+	bool StartReload(FWeaponSimState& weapon, const FWeaponSimConfig& config);
+	// Timer is reset before the weapon leaves the reload, not after
+	void FinishReload(FWeaponSimState& weapon, const FWeaponSimConfig& config);
+	// Cooldown is over
+	void FinishCooldown(FWeaponSimState& weapon);
+}
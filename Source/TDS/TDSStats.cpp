@@ -0,0 +1,32 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "TDSStats.h"
+
+CSV_DEFINE_CATEGORY_MODULE(TDS_API, TDS, true);
+UE_TRACE_CHANNEL_DEFINE(TDSChannel);
+
+DEFINE_STAT(STAT_TDS_CharacterTick);
+DEFINE_STAT(STAT_TDS_MovementTick);
+DEFINE_STAT(STAT_TDS_CursorTrace);
+DEFINE_STAT(STAT_TDS_InitWeapon);
+DEFINE_STAT(STAT_TDS_WeaponTick);
+DEFINE_STAT(STAT_TDS_WeaponFire);
+DEFINE_STAT(STAT_TDS_TraceHit);
+DEFINE_STAT(STAT_TDS_ProjectileHit);
+DEFINE_STAT(STAT_TDS_ProjectileSimulation);
+DEFINE_STAT(STAT_TDS_RadialDamage);
+DEFINE_STAT(STAT_TDS_FXPool);
+DEFINE_STAT(STAT_TDS_WeaponDebris);
+DEFINE_STAT(STAT_TDS_LagCompensation);
+DEFINE_STAT(STAT_TDS_FlowFieldBuild);
+DEFINE_STAT(STAT_TDS_FlowFieldSteering);
+DEFINE_STAT(STAT_TDS_Significance);
+DEFINE_STAT(STAT_TDS_DamageResolve);
+
+DEFINE_STAT(STAT_TDS_ShotsFired);
+DEFINE_STAT(STAT_TDS_ProjectilesAlive);
+DEFINE_STAT(STAT_TDS_TracesIssued);
+DEFINE_STAT(STAT_TDS_TimersRunning);
+DEFINE_STAT(STAT_TDS_FlowFieldAgents);
+DEFINE_STAT(STAT_TDS_LowSignificanceActors);
+DEFINE_STAT(STAT_TDS_DamageHits);
@@ -0,0 +1,59 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "Trace/Trace.h"
+
+// stat TDS, -csvprofile (category TDS) and Insights (-trace=cpu,TDS) show the same scopes under the same names
+
+DECLARE_STATS_GROUP(TEXT("TDS"), STATGROUP_TDS, STATCAT_Advanced);
+
+CSV_DECLARE_CATEGORY_MODULE_EXTERN(TDS_API, TDS);
+UE_TRACE_CHANNEL_EXTERN(TDSChannel, TDS_API);
+
+// ================================= Cycle counters =================================
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Character Tick"), STAT_TDS_CharacterTick, STATGROUP_TDS, TDS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Movement Tick"), STAT_TDS_MovementTick, STATGROUP_TDS, TDS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Cursor Trace"), STAT_TDS_CursorTrace, STATGROUP_TDS, TDS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Init Weapon"), STAT_TDS_InitWeapon, STATGROUP_TDS, TDS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Weapon Tick"), STAT_TDS_WeaponTick, STATGROUP_TDS, TDS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Weapon Fire"), STAT_TDS_WeaponFire, STATGROUP_TDS, TDS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Trace Hit"), STAT_TDS_TraceHit, STATGROUP_TDS, TDS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Projectile Hit"), STAT_TDS_ProjectileHit, STATGROUP_TDS, TDS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Projectile Simulation"), STAT_TDS_ProjectileSimulation, STATGROUP_TDS, TDS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Radial Damage"), STAT_TDS_RadialDamage, STATGROUP_TDS, TDS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("FX Pool"), STAT_TDS_FXPool, STATGROUP_TDS, TDS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Weapon Debris"), STAT_TDS_WeaponDebris, STATGROUP_TDS, TDS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Lag Compensation"), STAT_TDS_LagCompensation, STATGROUP_TDS, TDS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Flow Field Build"), STAT_TDS_FlowFieldBuild, STATGROUP_TDS, TDS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Flow Field Steering"), STAT_TDS_FlowFieldSteering, STATGROUP_TDS, TDS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Significance"), STAT_TDS_Significance, STATGROUP_TDS, TDS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Damage Resolve"), STAT_TDS_DamageResolve, STATGROUP_TDS, TDS_API);
+
+// ================================ Per-frame counters ================================
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Shots Fired"), STAT_TDS_ShotsFired, STATGROUP_TDS, TDS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Projectiles Alive"), STAT_TDS_ProjectilesAlive, STATGROUP_TDS, TDS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Traces Issued"), STAT_TDS_TracesIssued, STATGROUP_TDS, TDS_API);
+// Weapons firing, cooling down or reloading
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Timers Running"), STAT_TDS_TimersRunning, STATGROUP_TDS, TDS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Flow Field Agents"), STAT_TDS_FlowFieldAgents, STATGROUP_TDS, TDS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Low Significance Actors"), STAT_TDS_LowSignificanceActors, STATGROUP_TDS, TDS_API);
+// Hits resolved by UDamageSubsystem this frame
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Damage Hits"), STAT_TDS_DamageHits, STATGROUP_TDS, TDS_API);
+
+#define TDS_SCOPE_CYCLE_COUNTER(StatName) \
+	SCOPE_CYCLE_COUNTER(STAT_TDS_##StatName); \
+	CSV_SCOPED_TIMING_STAT(TDS, StatName); \
+	TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(TDS_##StatName, TDSChannel)
+
+#define TDS_INC_COUNTER(StatName, Amount) \
+	INC_DWORD_STAT_BY(STAT_TDS_##StatName, Amount); \
+	CSV_CUSTOM_STAT(TDS, StatName, static_cast<int32>(Amount), ECsvCustomStatOp::Accumulate)
+
+#define TDS_SET_COUNTER(StatName, Value) \
+	SET_DWORD_STAT(STAT_TDS_##StatName, Value); \
+	CSV_CUSTOM_STAT(TDS, StatName, static_cast<int32>(Value), ECsvCustomStatOp::Set)
@@ -0,0 +1,99 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DamageSubsystem.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "GameFramework/Controller.h"
+
+#include "../Character/HealthComponent.h"
+#include "../TDSStats.h"
+
+void UDamageSubsystem::Deinitialize()
+{
+	queuedDamage.Empty();
+	resolvingDamage.Empty();
+	resolvedDamage.Empty();
+
+	Super::Deinitialize();
+}
+
+TStatId UDamageSubsystem::GetStatId() const
+{ RETURN_QUICK_DECLARE_CYCLE_STAT(UDamageSubsystem, STATGROUP_Tickables); }
+
+void UDamageSubsystem::Tick(float DeltaTime)
+{
+	TDS_SET_COUNTER(DamageHits, queuedDamage.Num());
+
+	if (queuedDamage.Num() == 0)
+		return;
+
+	TDS_SCOPE_CYCLE_COUNTER(DamageResolve);
+
+	Swap(queuedDamage, resolvingDamage);
+	queuedDamage.Reset();
+	resolvedDamage.Reset();
+
+	for (const FQueuedDamage& hit : resolvingDamage)
+	{
+		UHealthComponent* myHealth = hit.healthComponent.Get();
+		if (!myHealth || myHealth->IsDead())
+			continue;
+
+		// Armor is taken from every hit, not from the sum
+		const float hitDamage = FMath::Max(hit.damage * myHealth->damageMultiplier - myHealth->armor, 0.f);
+		if (hitDamage <= 0.f)
+			continue;
+
+		int32 resolveIndex = myHealth->GetResolveIndex();
+		if (resolveIndex == INDEX_NONE)
+		{
+			resolveIndex = resolvedDamage.AddDefaulted();
+			resolvedDamage[resolveIndex].healthComponent = myHealth;
+			myHealth->SetResolveIndex(resolveIndex);
+		}
+
+		FResolvedDamage& resolved = resolvedDamage[resolveIndex];
+		resolved.damage += hitDamage;
+		resolved.numHits++;
+		if (hit.instigator.IsValid())
+			resolved.instigator = hit.instigator;
+	}
+
+	// Health events may destroy actors and queue new hits, the sums are done by then
+	for (const FResolvedDamage& resolved : resolvedDamage)
+	{
+		UHealthComponent* myHealth = resolved.healthComponent.Get();
+		if (!myHealth)
+			continue;
+
+		myHealth->SetResolveIndex(INDEX_NONE);
+		myHealth->ApplyResolvedDamage(resolved.damage, resolved.numHits, resolved.instigator.Get());
+	}
+}
+
+bool UDamageSubsystem::QueueDamage(AActor* target, float damage, FName boneName, AController* instigator)
+{
+	UHealthComponent* myHealth = target ? target->FindComponentByClass<UHealthComponent>() : nullptr;
+	if (!myHealth)
+		return false;
+
+	if (target->CanBeDamaged() && damage > 0.f)
+		QueueHealthDamage(myHealth, damage * myHealth->GetBoneMultiplier(boneName), instigator);
+
+	return true;
+}
+
+void UDamageSubsystem::QueueHealthDamage(UHealthComponent* healthComponent, float damage, AController* instigator)
+{
+	if (!healthComponent || healthComponent->IsDead() || damage <= 0.f)
+		return;
+
+	FQueuedDamage& newHit = queuedDamage.AddDefaulted_GetRef();
+	newHit.healthComponent = healthComponent;
+	newHit.damage = damage;
+	newHit.instigator = instigator;
+}
+
+int32 UDamageSubsystem::GetNumQueuedHits() const
+{ return queuedDamage.Num(); }
@@ -0,0 +1,56 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "../Game/TDSTickableWorldSubsystem.h"
+#include "DamageSubsystem.generated.h"
+
+class UHealthComponent;
+
+// Hit as it came in, bone multiplier already applied
+struct FQueuedDamage
+{
+	TWeakObjectPtr<UHealthComponent> healthComponent;
+	float damage = 0.f;
+	TWeakObjectPtr<AController> instigator;
+};
+
+// Everything a health component took this frame
+struct FResolvedDamage
+{
+	TWeakObjectPtr<UHealthComponent> healthComponent;
+	float damage = 0.f;
+	int32 numHits = 0;
+	// Of the last hit, the killer if the target dies
+	TWeakObjectPtr<AController> instigator;
+};
+
+// Projectiles, traces and explosions queue their hits on targets with a UHealthComponent instead of calling TakeDamage.
+// Once per frame armor and multipliers are applied per hit, the hits are summed per component
+// and every damaged component gets one health change. Targets without the component take the engine damage as before
+UCLASS()
+class TDS_API UDamageSubsystem : public UTDSTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// Returns false if the target has no health component, the caller applies the damage itself
+	bool QueueDamage(AActor* target, float damage, FName boneName, AController* instigator);
+	void QueueHealthDamage(UHealthComponent* healthComponent, float damage, AController* instigator);
+
+	UFUNCTION(BlueprintCallable)
+	int32 GetNumQueuedHits() const;
+
+private:
+	// Hits queued from the health callbacks are resolved on the next frame
+	TArray<FQueuedDamage> queuedDamage;
+	TArray<FQueuedDamage> resolvingDamage;
+	TArray<FResolvedDamage> resolvedDamage;
+};
@@ -0,0 +1,279 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FXPoolSubsystem.h"
+#include "Engine/World.h"
+#include "Components/DecalComponent.h"
+#include "Particles/ParticleSystem.h"
+#include "Particles/ParticleSystemComponent.h"
+#include "GameFramework/PlayerController.h"
+#include "Camera/PlayerCameraManager.h"
+
+#include "../TDS.h"
+#include "../TDSStats.h"
+
+bool UFXPoolSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{ return Super::ShouldCreateSubsystem(Outer) && !IsRunningDedicatedServer(); }
+
+void UFXPoolSubsystem::Deinitialize()
+{
+	emitterPools.Empty();
+	activeEmitters.Empty();
+	emitterExpireTimes.Empty();
+	decals.Empty();
+	decalExpireTimes.Empty();
+	fxActor = nullptr;
+
+	Super::Deinitialize();
+}
+
+TStatId UFXPoolSubsystem::GetStatId() const
+{ RETURN_QUICK_DECLARE_CYCLE_STAT(UFXPoolSubsystem, STATGROUP_Tickables); }
+
+void UFXPoolSubsystem::Tick(float DeltaTime)
+{
+	TDS_SCOPE_CYCLE_COUNTER(FXPool);
+
+	const float currentTime = GetWorld()->GetTimeSeconds();
+
+	// Backwards, ReleaseEmitter removes with RemoveAtSwap
+	for (int32 i = activeEmitters.Num() - 1; i >= 0; --i)
+		if (emitterExpireTimes[i] > 0.f && emitterExpireTimes[i] <= currentTime)
+			ReleaseEmitter(activeEmitters[i]);
+
+	for (int32 i = 0; i < decals.Num(); ++i)
+		if (decalExpireTimes[i] > 0.f && decalExpireTimes[i] <= currentTime)
+		{
+			decalExpireTimes[i] = 0.f;
+			if (decals[i])
+				decals[i]->SetVisibility(false);
+		}
+}
+
+UParticleSystemComponent* UFXPoolSubsystem::SpawnEmitter(UParticleSystem* emitterTemplate, const FVector& location, const FRotator& rotation)
+{
+	if (!emitterTemplate || !IsLocationVisible(location))
+		return nullptr;
+
+	UParticleSystemComponent* myEmitter = AcquireEmitter(emitterTemplate);
+	if (!myEmitter)
+		return nullptr;
+
+	myEmitter->SetWorldLocationAndRotation(location, rotation);
+	myEmitter->ActivateSystem(true);
+
+	return myEmitter;
+}
+
+UParticleSystemComponent* UFXPoolSubsystem::SpawnEmitterAttached(UParticleSystem* emitterTemplate, USceneComponent* attachTo, FName socketName)
+{
+	if (!emitterTemplate || !attachTo || !IsLocationVisible(attachTo->GetSocketLocation(socketName)))
+		return nullptr;
+
+	UParticleSystemComponent* myEmitter = AcquireEmitter(emitterTemplate);
+	if (!myEmitter)
+		return nullptr;
+
+	myEmitter->AttachToComponent(attachTo, FAttachmentTransformRules::SnapToTargetNotIncludingScale, socketName);
+	myEmitter->ActivateSystem(true);
+
+	return myEmitter;
+}
+
+void UFXPoolSubsystem::ReleaseEmitter(UParticleSystemComponent* emitter)
+{
+	if (!activeEmitters.Contains(emitter))
+		return;
+
+	// May call OnEmitterFinished itself, which then gives it back
+	emitter->DeactivateImmediate();
+	OnEmitterFinished(emitter);
+}
+
+UDecalComponent* UFXPoolSubsystem::SpawnDecal(UMaterialInterface* decalMaterial, const FVector& decalSize, const FVector& location, const FRotator& rotation, float lifeTime, USceneComponent* attachTo)
+{
+	if (!decalMaterial || decalCapacity <= 0 || !IsLocationVisible(location))
+		return nullptr;
+
+	UDecalComponent* myDecal = nullptr;
+	int32 decalIndex = INDEX_NONE;
+
+	// Ring buffer is filled up first, then the oldest decal is taken
+	if (decals.Num() < decalCapacity)
+	{
+		AActor* myFXActor = GetFXActor();
+		if (!myFXActor)
+			return nullptr;
+
+		myDecal = NewObject<UDecalComponent>(myFXActor);
+		myDecal->RegisterComponent();
+		decalIndex = decals.Add(myDecal);
+		decalExpireTimes.Add(0.f);
+	}
+	else
+	{
+		decalIndex = nextDecal % decals.Num();
+		nextDecal = (decalIndex + 1) % decals.Num();
+		myDecal = decals[decalIndex];
+
+		if (!IsValid(myDecal))
+		{
+			myDecal = NewObject<UDecalComponent>(GetFXActor());
+			myDecal->RegisterComponent();
+			decals[decalIndex] = myDecal;
+		}
+	}
+
+	decalExpireTimes[decalIndex] = lifeTime > 0.f ? GetWorld()->GetTimeSeconds() + lifeTime : 0.f;
+
+	if (attachTo)
+		myDecal->AttachToComponent(attachTo, FAttachmentTransformRules::KeepWorldTransform);
+	else if (myDecal->GetAttachParent())
+		myDecal->DetachFromComponent(FDetachmentTransformRules::KeepWorldTransform);
+
+	myDecal->SetDecalMaterial(decalMaterial);
+	myDecal->DecalSize = decalSize;
+	myDecal->SetWorldLocationAndRotation(location, rotation);
+	myDecal->SetVisibility(true);
+	myDecal->MarkRenderStateDirty();
+
+	return myDecal;
+}
+
+bool UFXPoolSubsystem::IsLocationVisible(const FVector& location)
+{
+	UWorld* world = GetWorld();
+
+	if (viewFrame != GFrameCounter)
+	{
+		viewFrame = GFrameCounter;
+		bHasView = false;
+
+		APlayerController* myController = world->GetFirstPlayerController();
+		if (myController && myController->PlayerCameraManager)
+		{
+			viewLocation = myController->PlayerCameraManager->GetCameraLocation();
+			myController->GetViewportSize(viewportSize.X, viewportSize.Y);
+			bHasView = true;
+		}
+	}
+
+	// Dedicated server or no camera yet, nothing to cull against
+	if (!bHasView)
+		return true;
+
+	bool bIsVisible = FVector::DistSquared(location, viewLocation) <= FMath::Square(maxSpawnDistance);
+
+	if (bIsVisible && viewportSize.X > 0 && viewportSize.Y > 0)
+	{
+		FVector2D screenLocation;
+		const FVector2D margin = FVector2D(viewportSize) * screenMargin;
+
+		bIsVisible = world->GetFirstPlayerController()->ProjectWorldLocationToScreen(location, screenLocation)
+			&& screenLocation.X >= -margin.X && screenLocation.X <= viewportSize.X + margin.X
+			&& screenLocation.Y >= -margin.Y && screenLocation.Y <= viewportSize.Y + margin.Y;
+	}
+
+	if (!bIsVisible)
+		culledSpawns++;
+
+	return bIsVisible;
+}
+
+UParticleSystemComponent* UFXPoolSubsystem::AcquireEmitter(UParticleSystem* emitterTemplate)
+{
+	FFXEmitterPool& pool = emitterPools.FindOrAdd(emitterTemplate);
+
+	if (pool.active >= maxEmittersPerTemplate)
+	{
+		culledSpawns++;
+		return nullptr;
+	}
+
+	UParticleSystemComponent* myEmitter = nullptr;
+
+	while (!myEmitter && pool.freeEmitters.Num() > 0)
+	{
+		myEmitter = pool.freeEmitters.Pop(false);
+		if (!IsValid(myEmitter))
+			myEmitter = nullptr;
+	}
+
+	if (!myEmitter)
+	{
+		AActor* myFXActor = GetFXActor();
+		if (!myFXActor)
+			return nullptr;
+
+		myEmitter = NewObject<UParticleSystemComponent>(myFXActor);
+		// Finished emitter comes back to the pool instead of being destroyed
+		myEmitter->bAutoDestroy = false;
+		myEmitter->bAutoActivate = false;
+		myEmitter->SetTemplate(emitterTemplate);
+		myEmitter->OnSystemFinished.AddDynamic(this, &UFXPoolSubsystem::OnEmitterFinished);
+		myEmitter->RegisterComponent();
+	}
+
+	pool.active++;
+	activeEmitters.Add(myEmitter);
+	emitterExpireTimes.Add(emitterTemplate->IsLooping() && loopingEmitterLifeTime > 0.f ? GetWorld()->GetTimeSeconds() + loopingEmitterLifeTime : 0.f);
+
+	return myEmitter;
+}
+
+void UFXPoolSubsystem::OnEmitterFinished(UParticleSystemComponent* emitter)
+{
+	const int32 activeIndex = activeEmitters.Find(emitter);
+	FFXEmitterPool* pool = emitter ? emitterPools.Find(emitter->Template) : nullptr;
+	if (activeIndex == INDEX_NONE || !pool)
+		return;
+
+	activeEmitters.RemoveAtSwap(activeIndex, 1, false);
+	emitterExpireTimes.RemoveAtSwap(activeIndex, 1, false);
+
+	if (emitter->GetAttachParent())
+		emitter->DetachFromComponent(FDetachmentTransformRules::KeepWorldTransform);
+
+	pool->active = FMath::Max(pool->active - 1, 0);
+	pool->freeEmitters.Add(emitter);
+}
+
+AActor* UFXPoolSubsystem::GetFXActor()
+{
+	if (!fxActor)
+	{
+		FActorSpawnParameters spawnParams;
+		spawnParams.ObjectFlags |= RF_Transient;
+		fxActor = GetWorld()->SpawnActor<AActor>(AActor::StaticClass(), FTransform::Identity, spawnParams);
+
+	}
+
+	return fxActor;
+}
+
+// ================================= Getters =================================
+FFXPoolStats UFXPoolSubsystem::GetPoolStats() const
+{
+	FFXPoolStats stats;
+
+	for (const auto& pool : emitterPools)
+	{
+		stats.activeEmitters += pool.Value.active;
+		stats.pooledEmitters += pool.Value.freeEmitters.Num();
+	}
+
+	for (const UDecalComponent* decal : decals)
+		stats.activeDecals += decal && decal->IsVisible() ? 1 : 0;
+
+	stats.pooledDecals = decals.Num();
+	stats.culledSpawns = culledSpawns;
+
+	return stats;
+}
+
+void UFXPoolSubsystem::LogPoolStats() const
+{
+	const FFXPoolStats stats = GetPoolStats();
+	UE_LOG(LogTDS, Log, TEXT("FX pool: emitters active %d, pooled %d, decals active %d, pooled %d (capacity %d), culled spawns %d"),
+		stats.activeEmitters, stats.pooledEmitters, stats.activeDecals, stats.pooledDecals, decalCapacity, stats.culledSpawns);
+}
@@ -0,0 +1,128 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "../Game/TDSTickableWorldSubsystem.h"
+#include "FXPoolSubsystem.generated.h"
+
+class UParticleSystem;
+class UParticleSystemComponent;
+class UDecalComponent;
+class UMaterialInterface;
+
+USTRUCT(BlueprintType)
+struct FFXPoolStats
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "Pool")
+	int32 activeEmitters = 0;
+	UPROPERTY(BlueprintReadOnly, Category = "Pool")
+	int32 pooledEmitters = 0;
+	UPROPERTY(BlueprintReadOnly, Category = "Pool")
+	int32 activeDecals = 0;
+	// Decal components created so far, never more than decalCapacity
+	UPROPERTY(BlueprintReadOnly, Category = "Pool")
+	int32 pooledDecals = 0;
+	// Spawns skipped as off-screen, too far or over the emitter cap
+	UPROPERTY(BlueprintReadOnly, Category = "Pool")
+	int32 culledSpawns = 0;
+};
+
+USTRUCT()
+struct FFXEmitterPool
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<UParticleSystemComponent*> freeEmitters;
+
+	int32 active = 0;
+};
+
+// Muzzle flashes, hit effects and hit decals: particle components are reused per template,
+// decals live in a ring buffer where the oldest one is taken for the next hit.
+// Looping templates never finish on their own, they are stopped after loopingEmitterLifeTime or by ReleaseEmitter
+UCLASS(Config = Game)
+class TDS_API UFXPoolSubsystem : public UTDSTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// Nothing to look at on a dedicated server
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Deinitialize() override;
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "FX")
+	int32 decalCapacity = 64;
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "FX")
+	int32 maxEmittersPerTemplate = 32;
+	// From the camera, the top-down camera sees nothing further
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "FX")
+	float maxSpawnDistance = 5000.f;
+	// Part of the viewport size around the screen where spawns are still made
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "FX")
+	float screenMargin = 0.1f;
+	// 0 keeps looping emitters until ReleaseEmitter
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "FX")
+	float loopingEmitterLifeTime = 2.f;
+
+	// Return null if the spawn was culled
+	UFUNCTION(BlueprintCallable)
+	UParticleSystemComponent* SpawnEmitter(UParticleSystem* emitterTemplate, const FVector& location, const FRotator& rotation);
+	UFUNCTION(BlueprintCallable)
+	UParticleSystemComponent* SpawnEmitterAttached(UParticleSystem* emitterTemplate, USceneComponent* attachTo, FName socketName = NAME_None);
+	// Stops the emitter at once and gives it back to the pool
+	UFUNCTION(BlueprintCallable)
+	void ReleaseEmitter(UParticleSystemComponent* emitter);
+	// Life time 0 keeps the decal until the ring buffer takes it back
+	UFUNCTION(BlueprintCallable)
+	UDecalComponent* SpawnDecal(UMaterialInterface* decalMaterial, const FVector& decalSize, const FVector& location, const FRotator& rotation, float lifeTime, USceneComponent* attachTo = nullptr);
+
+	UFUNCTION(BlueprintCallable)
+	bool IsLocationVisible(const FVector& location);
+
+	// ================================= Getters =================================
+	UFUNCTION(BlueprintCallable)
+	FFXPoolStats GetPoolStats() const;
+	UFUNCTION(BlueprintCallable)
+	void LogPoolStats() const;
+
+private:
+	UParticleSystemComponent* AcquireEmitter(UParticleSystem* emitterTemplate);
+	UFUNCTION()
+	void OnEmitterFinished(UParticleSystemComponent* emitter);
+
+	AActor* GetFXActor();
+
+	UPROPERTY()
+	AActor* fxActor = nullptr;
+
+	UPROPERTY()
+	TMap<UParticleSystem*, FFXEmitterPool> emitterPools;
+	// Emitters in use, 0 if the emitter finishes on its own
+	UPROPERTY()
+	TArray<UParticleSystemComponent*> activeEmitters;
+	TArray<float> emitterExpireTimes;
+
+	// ================================ Decals ================================
+	UPROPERTY()
+	TArray<UDecalComponent*> decals;
+	// 0 if the decal has no life time
+	TArray<float> decalExpireTimes;
+	// Oldest decal once the buffer is full
+	int32 nextDecal = 0;
+
+	int32 culledSpawns = 0;
+
+	// Camera of the frame, so visibility is not looked up per spawn
+	uint64 viewFrame = 0;
+	bool bHasView = false;
+	FVector viewLocation = FVector::ZeroVector;
+	FIntPoint viewportSize = FIntPoint::ZeroValue;
+};
@@ -0,0 +1,305 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "LagCompensationSubsystem.h"
+#include "Engine/World.h"
+#include "GameFramework/Character.h"
+#include "Components/CapsuleComponent.h"
+#include "DrawDebugHelpers.h"
+#include "HAL/IConsoleManager.h"
+
+#include "../TDS.h"
+#include "../TDSStats.h"
+
+static TAutoConsoleVariable<bool> CVarLagCompensationDebug(
+	TEXT("tds.LagCompensation.Debug"),
+	false,
+	TEXT("Draws the rewound capsule (green) and the live capsule (red) of every lag compensated hit."));
+
+// Distance along the ray (unit direction) to the sphere, not further than maxDistance
+static bool IntersectSphere(const FVector& start, const FVector& direction, float maxDistance, const FVector& center, float radius, float& outDistance)
+{
+	const FVector toStart = start - center;
+	const float b = FVector::DotProduct(toStart, direction);
+	const float c = toStart.SizeSquared() - radius * radius;
+
+	// Starts inside
+	if (c <= 0.f)
+	{
+		outDistance = 0.f;
+		return true;
+	}
+
+	const float discriminant = b * b - c;
+	if (discriminant < 0.f || b > 0.f)
+		return false;
+
+	const float distance = -b - FMath::Sqrt(discriminant);
+	if (distance > maxDistance)
+		return false;
+
+	outDistance = distance;
+	return true;
+}
+
+// Upright capsule is a vertical cylinder between two spheres
+static bool IntersectCapsule(const FVector& start, const FVector& direction, float maxDistance, const FVector& center, float radius, float halfHeight, float& outDistance)
+{
+	const float cylinderHalfHeight = FMath::Max(halfHeight - radius, 0.f);
+	float bestDistance = maxDistance;
+	bool bIsHit = false;
+
+	const FVector2D toStart(start.X - center.X, start.Y - center.Y);
+	const FVector2D direction2D(direction.X, direction.Y);
+	const float a = direction2D.SizeSquared();
+
+	if (a > KINDA_SMALL_NUMBER)
+	{
+		const float b = FVector2D::DotProduct(toStart, direction2D);
+		const float c = toStart.SizeSquared() - radius * radius;
+		const float discriminant = b * b - a * c;
+
+		if (discriminant >= 0.f)
+		{
+			const float root = FMath::Sqrt(discriminant);
+			const float exitDistance = (-b + root) / a;
+			const float distance = FMath::Max((-b - root) / a, 0.f);
+			const float hitZ = start.Z + direction.Z * distance - center.Z;
+
+			if (exitDistance >= 0.f && distance <= bestDistance && FMath::Abs(hitZ) <= cylinderHalfHeight)
+			{
+				bestDistance = distance;
+				bIsHit = true;
+			}
+		}
+	}
+
+	float capDistance = 0.f;
+	if (IntersectSphere(start, direction, bestDistance, center + FVector(0.f, 0.f, cylinderHalfHeight), radius, capDistance))
+	{
+		bestDistance = capDistance;
+		bIsHit = true;
+	}
+	if (IntersectSphere(start, direction, bestDistance, center - FVector(0.f, 0.f, cylinderHalfHeight), radius, capDistance))
+	{
+		bestDistance = capDistance;
+		bIsHit = true;
+	}
+
+	outDistance = bestDistance;
+	return bIsHit;
+}
+
+void ULagCompensationSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	historySize = FMath::Max(historySize, 2);
+	maxTargets = FMath::Max(maxTargets, 1);
+
+	// The only allocation, recording and rewinding reuse it
+	recordedCenters.SetNumZeroed(historySize * maxTargets);
+	frameTimes.SetNumZeroed(historySize);
+	targets.Reserve(maxTargets);
+	targetRadiuses.Reserve(maxTargets);
+	targetHalfHeights.Reserve(maxTargets);
+}
+
+void ULagCompensationSubsystem::Deinitialize()
+{
+	targets.Empty();
+	targetRadiuses.Empty();
+	targetHalfHeights.Empty();
+	recordedCenters.Empty();
+	frameTimes.Empty();
+	headFrame = INDEX_NONE;
+	numFrames = 0;
+
+	Super::Deinitialize();
+}
+
+TStatId ULagCompensationSubsystem::GetStatId() const
+{ RETURN_QUICK_DECLARE_CYCLE_STAT(ULagCompensationSubsystem, STATGROUP_Tickables); }
+
+void ULagCompensationSubsystem::Tick(float DeltaTime)
+{
+	if (!IsActive())
+		return;
+
+	TDS_SCOPE_CYCLE_COUNTER(LagCompensation);
+
+	// Tickables run after the actors, the capsules are where this tick left them
+	RecordFrame();
+}
+
+void ULagCompensationSubsystem::RegisterTarget(ACharacter* target)
+{
+	if (!target || !target->GetCapsuleComponent() || targets.Contains(target))
+		return;
+
+	if (targets.Num() >= maxTargets)
+	{
+		UE_LOG(LogTDS, Warning, TEXT("ULagCompensationSubsystem::RegisterTarget - %s is not compensated, maxTargets (%d) reached"), *target->GetName(), maxTargets);
+		return;
+	}
+
+	const int32 targetIndex = targets.Add(target);
+	targetRadiuses.Add(target->GetCapsuleComponent()->GetScaledCapsuleRadius());
+	targetHalfHeights.Add(target->GetCapsuleComponent()->GetScaledCapsuleHalfHeight());
+
+	// No history yet, the target stood where it is now
+	for (int32 frame = 0; frame < historySize; ++frame)
+		recordedCenters[frame * maxTargets + targetIndex] = target->GetActorLocation();
+}
+
+void ULagCompensationSubsystem::UnregisterTarget(ACharacter* target)
+{
+	const int32 targetIndex = targets.IndexOfByKey(target);
+	if (targetIndex != INDEX_NONE)
+		RemoveTarget(targetIndex);
+}
+
+bool ULagCompensationSubsystem::IsActive() const
+{
+	const ENetMode netMode = GetWorld()->GetNetMode();
+	return netMode == NM_ListenServer || netMode == NM_DedicatedServer;
+}
+
+bool ULagCompensationSubsystem::TraceRewound(FHitResult& outHit, const FVector& start, const FVector& end, float rewindTime, const AActor* ignoredActor) const
+{
+	if (numFrames == 0 || targets.Num() == 0)
+		return false;
+
+	TDS_SCOPE_CYCLE_COUNTER(LagCompensation);
+
+	const FVector segment = end - start;
+	const float length = segment.Size();
+	if (length <= KINDA_SMALL_NUMBER)
+		return false;
+
+	const FVector direction = segment / length;
+
+	int32 newerFrame = 0;
+	int32 olderFrame = 0;
+	float alpha = 0.f;
+	FindFrames(FMath::Max(rewindTime, GetWorld()->GetTimeSeconds() - maxRewindTime), newerFrame, olderFrame, alpha);
+
+	int32 hitTarget = INDEX_NONE;
+	FVector hitCenter = FVector::ZeroVector;
+	float hitDistance = length;
+
+	for (int32 i = 0; i < targets.Num(); ++i)
+	{
+		const ACharacter* target = targets[i].Get();
+		if (!target || target == ignoredActor)
+			continue;
+
+		const FVector center = GetRewoundCenter(i, newerFrame, olderFrame, alpha);
+		float distance = 0.f;
+		if (IntersectCapsule(start, direction, hitDistance, center, targetRadiuses[i], targetHalfHeights[i], distance))
+		{
+			hitTarget = i;
+			hitCenter = center;
+			hitDistance = distance;
+		}
+	}
+
+	if (hitTarget == INDEX_NONE)
+		return false;
+
+	ACharacter* target = targets[hitTarget].Get();
+	const FVector hitLocation = start + direction * hitDistance;
+	const float cylinderHalfHeight = FMath::Max(targetHalfHeights[hitTarget] - targetRadiuses[hitTarget], 0.f);
+	const FVector axisPoint = hitCenter + FVector(0.f, 0.f, FMath::Clamp(hitLocation.Z - hitCenter.Z, -cylinderHalfHeight, cylinderHalfHeight));
+
+	outHit = FHitResult(target, target->GetCapsuleComponent(), hitLocation, (hitLocation - axisPoint).GetSafeNormal());
+	outHit.bBlockingHit = true;
+	outHit.TraceStart = start;
+	outHit.TraceEnd = end;
+	outHit.Distance = hitDistance;
+	outHit.Time = hitDistance / length;
+
+#if ENABLE_DRAW_DEBUG
+	if (CVarLagCompensationDebug.GetValueOnGameThread())
+	{
+		const float radius = targetRadiuses[hitTarget];
+		const float halfHeight = targetHalfHeights[hitTarget];
+		DrawDebugCapsule(GetWorld(), hitCenter, halfHeight, radius, FQuat::Identity, FColor::Green, false, 2.f);
+		DrawDebugCapsule(GetWorld(), target->GetActorLocation(), halfHeight, radius, FQuat::Identity, FColor::Red, false, 2.f);
+		DrawDebugLine(GetWorld(), start, hitLocation, FColor::Yellow, false, 2.f);
+	}
+#endif
+
+	return true;
+}
+
+void ULagCompensationSubsystem::AddIgnoredTargets(FCollisionQueryParams& queryParams) const
+{
+	for (const TWeakObjectPtr<ACharacter>& target : targets)
+		if (target.IsValid())
+			queryParams.AddIgnoredActor(target.Get());
+}
+
+int32 ULagCompensationSubsystem::GetNumTargets() const
+{ return targets.Num(); }
+
+void ULagCompensationSubsystem::RecordFrame()
+{
+	for (int32 i = targets.Num() - 1; i >= 0; --i)
+		if (!targets[i].IsValid())
+			RemoveTarget(i);
+
+	headFrame = (headFrame + 1) % historySize;
+	numFrames = FMath::Min(numFrames + 1, historySize);
+	frameTimes[headFrame] = GetWorld()->GetTimeSeconds();
+
+	FVector* frameCenters = recordedCenters.GetData() + headFrame * maxTargets;
+	for (int32 i = 0; i < targets.Num(); ++i)
+		frameCenters[i] = targets[i]->GetActorLocation();
+}
+
+void ULagCompensationSubsystem::RemoveTarget(int32 targetIndex)
+{
+	// The last target takes the freed column in every recorded tick
+	const int32 lastIndex = targets.Num() - 1;
+	if (targetIndex != lastIndex)
+		for (int32 frame = 0; frame < historySize; ++frame)
+			recordedCenters[frame * maxTargets + targetIndex] = recordedCenters[frame * maxTargets + lastIndex];
+
+	targets.RemoveAtSwap(targetIndex, 1, false);
+	targetRadiuses.RemoveAtSwap(targetIndex, 1, false);
+	targetHalfHeights.RemoveAtSwap(targetIndex, 1, false);
+}
+
+FVector ULagCompensationSubsystem::GetRewoundCenter(int32 targetIndex, int32 newerFrame, int32 olderFrame, float alpha) const
+{
+	const FVector& newerCenter = recordedCenters[newerFrame * maxTargets + targetIndex];
+	const FVector& olderCenter = recordedCenters[olderFrame * maxTargets + targetIndex];
+	return FMath::Lerp(newerCenter, olderCenter, alpha);
+}
+
+void ULagCompensationSubsystem::FindFrames(float rewindTime, int32& outNewerFrame, int32& outOlderFrame, float& outAlpha) const
+{
+	outNewerFrame = headFrame;
+	outOlderFrame = headFrame;
+	outAlpha = 0.f;
+
+	// Newest first, the first tick not later than the rewind time is the older one
+	for (int32 age = 0; age < numFrames; ++age)
+	{
+		const int32 frame = (headFrame - age + historySize) % historySize;
+		outOlderFrame = frame;
+
+		if (frameTimes[frame] <= rewindTime)
+		{
+			const float frameGap = frameTimes[outNewerFrame] - frameTimes[frame];
+			outAlpha = frameGap > 0.f ? (frameTimes[outNewerFrame] - rewindTime) / frameGap : 0.f;
+			return;
+		}
+
+		outNewerFrame = frame;
+	}
+
+	// Older than the whole history, the oldest tick is the best guess
+	outNewerFrame = outOlderFrame;
+}
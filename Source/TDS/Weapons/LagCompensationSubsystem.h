@@ -0,0 +1,72 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineTypes.h"
+
+#include "../Game/TDSTickableWorldSubsystem.h"
+#include "LagCompensationSubsystem.generated.h"
+
+class ACharacter;
+
+// Server keeps the capsules of all characters for the last historySize ticks. A trace shot is tested against
+// the capsules as they were when the shooter saw them, interpolated between the two recorded ticks around that time
+UCLASS(Config = Game)
+class TDS_API ULagCompensationSubsystem : public UTDSTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// Recorded ticks, about a second at 60 Hz
+	UPROPERTY(Config, EditAnywhere, Category = "Lag compensation")
+	int32 historySize = 64;
+	// Characters past this number are not compensated, the history is allocated once for all of them
+	UPROPERTY(Config, EditAnywhere, Category = "Lag compensation")
+	int32 maxTargets = 32;
+	// Shots are never rewound further back than this, whatever the ping
+	UPROPERTY(Config, EditAnywhere, Category = "Lag compensation")
+	float maxRewindTime = 0.4f;
+
+	UFUNCTION(BlueprintCallable)
+	void RegisterTarget(ACharacter* target);
+	UFUNCTION(BlueprintCallable)
+	void UnregisterTarget(ACharacter* target);
+
+	// Server only, there is nothing recorded on clients
+	bool IsActive() const;
+
+	// Traces against the rewound capsules only, the level is traced by the caller
+	bool TraceRewound(FHitResult& outHit, const FVector& start, const FVector& end, float rewindTime, const AActor* ignoredActor) const;
+	// Level traces skip the live capsules of the targets, they are hit in the past instead
+	void AddIgnoredTargets(FCollisionQueryParams& queryParams) const;
+
+	UFUNCTION(BlueprintCallable)
+	int32 GetNumTargets() const;
+
+private:
+	void RecordFrame();
+	void RemoveTarget(int32 targetIndex);
+	// Capsule center of the target at the time, between the two closest recorded ticks
+	FVector GetRewoundCenter(int32 targetIndex, int32 newerFrame, int32 olderFrame, float alpha) const;
+	// Ring indices of the recorded ticks around the time, newer one first
+	void FindFrames(float rewindTime, int32& outNewerFrame, int32& outOlderFrame, float& outAlpha) const;
+
+	// Capsules are upright, only their centers move
+	TArray<TWeakObjectPtr<ACharacter>> targets;
+	TArray<float> targetRadiuses;
+	TArray<float> targetHalfHeights;
+
+	// ================================ History ================================
+	// historySize x maxTargets centers, one tick after another, so a rewind reads two contiguous rows
+	TArray<FVector> recordedCenters;
+	TArray<float> frameTimes;
+	int32 headFrame = INDEX_NONE;
+	int32 numFrames = 0;
+};
@@ -0,0 +1,151 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProjectilePoolSubsystem.h"
+#include "Engine/World.h"
+
+#include "Projectile_Base.h"
+#include "../../TDS.h"
+
+bool UProjectilePoolSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	UWorld* world = Cast<UWorld>(Outer);
+	return world && world->IsGameWorld();
+}
+
+void UProjectilePoolSubsystem::Deinitialize()
+{
+	pools.Empty();
+
+	Super::Deinitialize();
+}
+
+void UProjectilePoolSubsystem::PrewarmPool(TSubclassOf<AProjectile_Base> projectileClass, int32 count)
+{
+	if (!projectileClass)
+		return;
+
+	FProjectilePool& pool = pools.FindOrAdd(projectileClass);
+	const int32 numToSpawn = count - (pool.freeProjectiles.Num() + pool.stats.active);
+
+	for (int32 i = 0; i < numToSpawn; ++i)
+	{
+		AProjectile_Base* newProjectile = SpawnPooledProjectile(projectileClass);
+		if (newProjectile)
+			pool.freeProjectiles.Add(newProjectile);
+	}
+
+	pool.stats.pooled = pool.freeProjectiles.Num();
+}
+
+AProjectile_Base* UProjectilePoolSubsystem::AcquireProjectile(const FProjectileInfo& projectileInfo, const FVector& location, const FRotator& rotation, AActor* newOwner, APawn* newInstigator)
+{
+	if (!projectileInfo.projectile)
+		return nullptr;
+
+	if (!pools.Contains(projectileInfo.projectile))
+		PrewarmPool(projectileInfo.projectile, prewarmCount);
+
+	FProjectilePool& pool = pools.FindChecked(projectileInfo.projectile);
+	AProjectile_Base* myProjectile = nullptr;
+
+	// Pooled actors can be destroyed from outside (level streaming, editor), skip them
+	while (!myProjectile && pool.freeProjectiles.Num() > 0)
+	{
+		myProjectile = pool.freeProjectiles.Pop(false);
+		if (!IsValid(myProjectile))
+			myProjectile = nullptr;
+	}
+
+	if (myProjectile)
+		pool.stats.poolHits++;
+	else
+	{
+		myProjectile = SpawnPooledProjectile(projectileInfo.projectile);
+		if (!myProjectile)
+			return nullptr;
+		pool.stats.poolMisses++;
+	}
+
+	pool.stats.active++;
+	pool.stats.highWater = FMath::Max(pool.stats.highWater, pool.stats.active);
+	pool.stats.pooled = pool.freeProjectiles.Num();
+
+	myProjectile->SetOwner(newOwner);
+	myProjectile->SetInstigator(newInstigator);
+	myProjectile->InitProjectile(projectileInfo);
+	myProjectile->ActivateProjectile(location, rotation);
+
+	return myProjectile;
+}
+
+void UProjectilePoolSubsystem::ReleaseProjectile(AProjectile_Base* projectile)
+{
+	if (!IsValid(projectile) || !projectile->IsProjectileActive())
+		return;
+
+	projectile->DeactivateProjectile();
+
+	FProjectilePool* pool = pools.Find(projectile->GetClass());
+	if (!pool)
+	{
+		// Was not spawned by the pool
+		projectile->Destroy();
+		return;
+	}
+
+	pool->stats.active = FMath::Max(pool->stats.active - 1, 0);
+	pool->freeProjectiles.Add(projectile);
+	pool->stats.pooled = pool->freeProjectiles.Num();
+}
+
+AProjectile_Base* UProjectilePoolSubsystem::SpawnPooledProjectile(UClass* projectileClass)
+{
+	UWorld* world = GetWorld();
+	if (!world)
+		return nullptr;
+
+	FActorSpawnParameters spawnParams;
+	spawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	AProjectile_Base* newProjectile = world->SpawnActor<AProjectile_Base>(projectileClass, FTransform::Identity, spawnParams);
+	if (newProjectile)
+		newProjectile->DeactivateProjectile();
+	else
+		UE_LOG(LogTDS, Warning, TEXT("UProjectilePoolSubsystem::SpawnPooledProjectile - failed to spawn %s"), *GetNameSafe(projectileClass));
+
+	return newProjectile;
+}
+
+// ================================= Getters =================================
+FProjectilePoolStats UProjectilePoolSubsystem::GetPoolStats(TSubclassOf<AProjectile_Base> projectileClass) const
+{
+	const FProjectilePool* pool = pools.Find(projectileClass);
+	return pool ? pool->stats : FProjectilePoolStats();
+}
+
+FProjectilePoolStats UProjectilePoolSubsystem::GetTotalPoolStats() const
+{
+	FProjectilePoolStats totalStats;
+
+	for (const auto& pool : pools)
+	{
+		totalStats.poolHits += pool.Value.stats.poolHits;
+		totalStats.poolMisses += pool.Value.stats.poolMisses;
+		totalStats.highWater += pool.Value.stats.highWater;
+		totalStats.active += pool.Value.stats.active;
+		totalStats.pooled += pool.Value.stats.pooled;
+	}
+
+	return totalStats;
+}
+
+void UProjectilePoolSubsystem::LogPoolStats() const
+{
+	for (const auto& pool : pools)
+	{
+		const FProjectilePoolStats& stats = pool.Value.stats;
+		UE_LOG(LogTDS, Log, TEXT("Projectile pool %s: hits %d, misses %d, high water %d, active %d, pooled %d"),
+			*GetNameSafe(pool.Key), stats.poolHits, stats.poolMisses, stats.highWater, stats.active, stats.pooled);
+	}
+}
@@ -0,0 +1,79 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+
+#include "../../FuncLibrary/Types.h"
+#include "ProjectilePoolSubsystem.generated.h"
+
+class AProjectile_Base;
+
+USTRUCT(BlueprintType)
+struct FProjectilePoolStats
+{
+	GENERATED_BODY()
+
+	// Projectile taken from the pool
+	UPROPERTY(BlueprintReadOnly, Category = "Pool")
+	int32 poolHits = 0;
+	// Pool was empty and a new projectile was spawned
+	UPROPERTY(BlueprintReadOnly, Category = "Pool")
+	int32 poolMisses = 0;
+	// Max number of projectiles in flight at once
+	UPROPERTY(BlueprintReadOnly, Category = "Pool")
+	int32 highWater = 0;
+	UPROPERTY(BlueprintReadOnly, Category = "Pool")
+	int32 active = 0;
+	UPROPERTY(BlueprintReadOnly, Category = "Pool")
+	int32 pooled = 0;
+};
+
+USTRUCT()
+struct FProjectilePool
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<AProjectile_Base*> freeProjectiles;
+
+	FProjectilePoolStats stats;
+};
+
+// Keeps projectiles alive between shots so the weapons don't spawn and destroy an actor per round
+UCLASS(Config = Game)
+class TDS_API UProjectilePoolSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Deinitialize() override;
+
+	// How many projectiles are spawned for each class the first time it is used
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "Pool")
+	int32 prewarmCount = 16;
+
+	UFUNCTION(BlueprintCallable)
+	void PrewarmPool(TSubclassOf<AProjectile_Base> projectileClass, int32 count);
+
+	// Takes a free projectile (or spawns one), resets it by InitProjectile and launches it
+	AProjectile_Base* AcquireProjectile(const FProjectileInfo& projectileInfo, const FVector& location, const FRotator& rotation, AActor* newOwner, APawn* newInstigator);
+	// Called on impact or when life time is over
+	void ReleaseProjectile(AProjectile_Base* projectile);
+
+	// ================================= Getters =================================
+	UFUNCTION(BlueprintCallable)
+	FProjectilePoolStats GetPoolStats(TSubclassOf<AProjectile_Base> projectileClass) const;
+	UFUNCTION(BlueprintCallable)
+	FProjectilePoolStats GetTotalPoolStats() const;
+	UFUNCTION(BlueprintCallable)
+	void LogPoolStats() const;
+
+private:
+	AProjectile_Base* SpawnPooledProjectile(UClass* projectileClass);
+
+	UPROPERTY()
+	TMap<UClass*, FProjectilePool> pools;
+};
@@ -0,0 +1,329 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProjectileSimulationSubsystem.h"
+#include "Engine/World.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "GameFramework/DamageType.h"
+#include "Kismet/GameplayStatics.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+
+#include "Projectile_Base.h"
+#include "../RadialDamageSubsystem.h"
+#include "../DamageSubsystem.h"
+#include "ProjectilePoolSubsystem.h"
+#include "../../TDSStats.h"
+
+static TAutoConsoleVariable<int32> CVarProjectileParallelMinCount(
+	TEXT("tds.Projectile.ParallelMinCount"),
+	256,
+	TEXT("Simulated projectiles are moved with ParallelFor when there are at least this many in flight (0 = always single thread)."));
+
+// Free instance of the pool
+static const FTransform hiddenTransform(FQuat::Identity, FVector::ZeroVector, FVector::ZeroVector);
+
+void UProjectileSimulationSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	sweepDelegate.BindUObject(this, &UProjectileSimulationSubsystem::OnSweepCompleted);
+}
+
+void UProjectileSimulationSubsystem::Deinitialize()
+{
+	sweepDelegate.Unbind();
+	sweepHits.Empty();
+	positions.Empty();
+	previousPositions.Empty();
+	velocities.Empty();
+	lifeTimes.Empty();
+	damageParams.Empty();
+	typeIndices.Empty();
+	instigators.Empty();
+	projectileIds.Empty();
+	projectileTypes.Empty();
+	typeIndexByClass.Empty();
+	meshComponents.Empty();
+	instanceTransforms.Empty();
+	visibleInstances.Empty();
+	hiddenTransforms.Empty();
+	renderActor = nullptr;
+
+	Super::Deinitialize();
+}
+
+TStatId UProjectileSimulationSubsystem::GetStatId() const
+{ RETURN_QUICK_DECLARE_CYCLE_STAT(UProjectileSimulationSubsystem, STATGROUP_Tickables); }
+
+void UProjectileSimulationSubsystem::Tick(float DeltaTime)
+{
+	const UProjectilePoolSubsystem* myPool = GetWorld()->GetSubsystem<UProjectilePoolSubsystem>();
+	TDS_SET_COUNTER(ProjectilesAlive, positions.Num() + (myPool ? myPool->GetTotalPoolStats().active : 0));
+
+	// The last instances are hidden in the frame after the last projectile
+	if (positions.Num() == 0 && !bIsInstancesVisible)
+	{
+		sweepHits.Reset();
+		return;
+	}
+
+	TDS_SCOPE_CYCLE_COUNTER(ProjectileSimulation);
+
+	ApplySweepHits();
+	MoveProjectiles(DeltaTime);
+	SweepProjectiles();
+	UpdateInstances();
+}
+
+void UProjectileSimulationSubsystem::AddProjectile(const FProjectileInfo& projectileInfo, const FVector& location, const FVector& direction, APawn* newInstigator)
+{
+	const int32 typeIndex = FindOrAddProjectileType(projectileInfo.projectile);
+	if (typeIndex == INDEX_NONE)
+		return;
+
+	positions.Add(location);
+	previousPositions.Add(location);
+	velocities.Add(direction.GetSafeNormal() * projectileInfo.projectileInitSpeed);
+	lifeTimes.Add(projectileInfo.projectileLifeTime);
+	damageParams.Add(URadialDamageSubsystem::MakeDamageParams(projectileInfo));
+	typeIndices.Add(typeIndex);
+	instigators.Add(newInstigator);
+	projectileIds.Add(nextProjectileId++);
+}
+
+void UProjectileSimulationSubsystem::AddProjectiles(const FProjectileInfo& projectileInfo, const TArray<FWeaponShot>& shots, APawn* newInstigator)
+{
+	for (const FWeaponShot& shot : shots)
+		AddProjectile(projectileInfo, shot.location + shot.direction * projectileInfo.projectileInitSpeed * shot.timeOffset, shot.direction, newInstigator);
+}
+
+int32 UProjectileSimulationSubsystem::GetNumProjectiles() const
+{ return positions.Num(); }
+
+int32 UProjectileSimulationSubsystem::FindOrAddProjectileType(UClass* projectileClass)
+{
+	if (!projectileClass)
+		return INDEX_NONE;
+
+	if (const int32* typeIndex = typeIndexByClass.Find(projectileClass))
+		return *typeIndex;
+
+	const AProjectile_Base* defaultProjectile = projectileClass->GetDefaultObject<AProjectile_Base>();
+	if (!defaultProjectile)
+		return INDEX_NONE;
+
+	FSimulatedProjectileType newType;
+
+	if (defaultProjectile->bulletMesh && defaultProjectile->bulletMesh->GetStaticMesh())
+	{
+		newType.meshComponentIndex = FindOrAddMeshComponent(defaultProjectile->bulletMesh->GetStaticMesh());
+		newType.meshTransform = defaultProjectile->bulletMesh->GetRelativeTransform();
+	}
+
+	if (defaultProjectile->bulletProjectileMovement)
+		newType.gravityZ = GetWorld()->GetGravityZ() * defaultProjectile->bulletProjectileMovement->ProjectileGravityScale;
+
+	if (defaultProjectile->bulletCollisionSphere)
+	{
+		newType.collisionRadius = defaultProjectile->bulletCollisionSphere->GetUnscaledSphereRadius();
+		newType.collisionChannel = defaultProjectile->bulletCollisionSphere->GetCollisionObjectType();
+		newType.collisionResponse = FCollisionResponseParams(defaultProjectile->bulletCollisionSphere->GetCollisionResponseToChannels());
+	}
+
+	const int32 newTypeIndex = projectileTypes.Add(newType);
+	typeIndexByClass.Add(projectileClass, newTypeIndex);
+
+	return newTypeIndex;
+}
+
+int32 UProjectileSimulationSubsystem::FindOrAddMeshComponent(UStaticMesh* mesh)
+{
+	for (int32 i = 0; i < meshComponents.Num(); ++i)
+		if (meshComponents[i]->GetStaticMesh() == mesh)
+			return i;
+
+	if (!renderActor)
+	{
+		FActorSpawnParameters spawnParams;
+		spawnParams.ObjectFlags |= RF_Transient;
+		renderActor = GetWorld()->SpawnActor<AActor>(AActor::StaticClass(), FTransform::Identity, spawnParams);
+	}
+
+	if (!renderActor)
+		return INDEX_NONE;
+
+	UInstancedStaticMeshComponent* newMeshComponent = NewObject<UInstancedStaticMeshComponent>(renderActor);
+	newMeshComponent->SetStaticMesh(mesh);
+	newMeshComponent->SetMobility(EComponentMobility::Movable);
+	newMeshComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	newMeshComponent->SetCanEverAffectNavigation(false);
+	newMeshComponent->SetCastShadow(false);
+
+	if (renderActor->GetRootComponent())
+		newMeshComponent->SetupAttachment(renderActor->GetRootComponent());
+	else
+		renderActor->SetRootComponent(newMeshComponent);
+
+	newMeshComponent->RegisterComponent();
+
+	instanceTransforms.AddDefaulted();
+	visibleInstances.Add(0);
+	return meshComponents.Add(newMeshComponent);
+}
+
+void UProjectileSimulationSubsystem::MoveProjectiles(float DeltaTime)
+{
+	const int32 parallelMinCount = CVarProjectileParallelMinCount.GetValueOnGameThread();
+	const bool bForceSingleThread = parallelMinCount <= 0 || positions.Num() < parallelMinCount;
+
+	ParallelFor(positions.Num(), [this, DeltaTime](int32 i)
+	{
+		previousPositions[i] = positions[i];
+		velocities[i].Z += projectileTypes[typeIndices[i]].gravityZ * DeltaTime;
+		positions[i] += velocities[i] * DeltaTime;
+		lifeTimes[i] -= DeltaTime;
+	}, bForceSingleThread);
+}
+
+void UProjectileSimulationSubsystem::ApplySweepHits()
+{
+	UWorld* world = GetWorld();
+	URadialDamageSubsystem* myRadialDamage = world->GetSubsystem<URadialDamageSubsystem>();
+	UDamageSubsystem* myDamage = world->GetSubsystem<UDamageSubsystem>();
+	const bool bIsClient = world->GetNetMode() == NM_Client;
+
+	// Backwards so RemoveAtSwap only brings in projectiles which are already handled
+	for (int32 i = positions.Num() - 1; i >= 0; --i)
+	{
+		FHitResult hitResult;
+		if (!sweepHits.RemoveAndCopyValue(projectileIds[i], hitResult))
+		{
+			if (lifeTimes[i] <= 0.f)
+				RemoveProjectile(i);
+			continue;
+		}
+
+		APawn* myInstigator = instigators[i].Get();
+		AController* instigatorController = myInstigator ? myInstigator->GetController() : nullptr;
+
+		// Simulated rounds don't bounce, first blocking hit is the impact. Clients only show it
+		if (bIsClient)
+		{
+			RemoveProjectile(i);
+			continue;
+		}
+
+		if (damageParams[i].OuterRadius > 0.f)
+		{
+			if (myRadialDamage)
+				myRadialDamage->QueueExplosion(hitResult.Location, damageParams[i], myInstigator, instigatorController);
+		}
+		else if (hitResult.GetActor() && (!myDamage || !myDamage->QueueDamage(hitResult.GetActor(), damageParams[i].BaseDamage, hitResult.BoneName, instigatorController)))
+			UGameplayStatics::ApplyPointDamage(hitResult.GetActor(), damageParams[i].BaseDamage, velocities[i].GetSafeNormal(), hitResult, instigatorController, myInstigator, UDamageType::StaticClass());
+
+		RemoveProjectile(i);
+	}
+
+	// Hits of projectiles that are gone by now
+	sweepHits.Reset();
+}
+
+void UProjectileSimulationSubsystem::SweepProjectiles()
+{
+	UWorld* world = GetWorld();
+	FCollisionQueryParams queryParams(SCENE_QUERY_STAT(SimulatedProjectileSweep), false);
+
+	int32 numSweeps = 0;
+
+	// Traced together with the other async traces of the frame, the hits come back before the next tick
+	for (int32 i = 0; i < positions.Num(); ++i)
+	{
+		// Removed at the start of the next frame
+		if (lifeTimes[i] <= 0.f)
+			continue;
+
+		const FSimulatedProjectileType& projectileType = projectileTypes[typeIndices[i]];
+
+		queryParams.ClearIgnoredActors();
+		if (APawn* myInstigator = instigators[i].Get())
+			queryParams.AddIgnoredActor(myInstigator);
+
+		world->AsyncSweepByChannel(EAsyncTraceType::Single, previousPositions[i], positions[i], FQuat::Identity, projectileType.collisionChannel,
+			FCollisionShape::MakeSphere(projectileType.collisionRadius), queryParams, projectileType.collisionResponse, &sweepDelegate, projectileIds[i]);
+		numSweeps++;
+	}
+
+	TDS_INC_COUNTER(TracesIssued, numSweeps);
+}
+
+void UProjectileSimulationSubsystem::OnSweepCompleted(const FTraceHandle& traceHandle, FTraceDatum& traceDatum)
+{
+	for (const FHitResult& hitResult : traceDatum.OutHits)
+	{
+		if (hitResult.bBlockingHit)
+		{
+			sweepHits.Add(traceDatum.UserData, hitResult);
+			return;
+		}
+	}
+}
+
+void UProjectileSimulationSubsystem::RemoveProjectile(int32 index)
+{
+	positions.RemoveAtSwap(index, 1, false);
+	previousPositions.RemoveAtSwap(index, 1, false);
+	velocities.RemoveAtSwap(index, 1, false);
+	lifeTimes.RemoveAtSwap(index, 1, false);
+	damageParams.RemoveAtSwap(index, 1, false);
+	typeIndices.RemoveAtSwap(index, 1, false);
+	instigators.RemoveAtSwap(index, 1, false);
+	projectileIds.RemoveAtSwap(index, 1, false);
+}
+
+void UProjectileSimulationSubsystem::UpdateInstances()
+{
+	for (TArray<FTransform>& transforms : instanceTransforms)
+		transforms.Reset();
+
+	for (int32 i = 0; i < positions.Num(); ++i)
+	{
+		const FSimulatedProjectileType& projectileType = projectileTypes[typeIndices[i]];
+		if (projectileType.meshComponentIndex == INDEX_NONE)
+			continue;
+
+		const FTransform projectileTransform(velocities[i].Rotation(), positions[i]);
+		instanceTransforms[projectileType.meshComponentIndex].Add(projectileType.meshTransform * projectileTransform);
+	}
+
+	bIsInstancesVisible = false;
+
+	for (int32 i = 0; i < meshComponents.Num(); ++i)
+	{
+		UInstancedStaticMeshComponent* meshComponent = meshComponents[i];
+		TArray<FTransform>& transforms = instanceTransforms[i];
+
+		const int32 numVisible = transforms.Num();
+		const int32 numUpdated = FMath::Max(numVisible, visibleInstances[i]);
+		visibleInstances[i] = numVisible;
+		bIsInstancesVisible |= numVisible > 0;
+
+		// Nothing shown now or in the last frame
+		if (numUpdated == 0)
+			continue;
+
+		// Pool only grows, by powers of two so a growing salvo adds instances a few times only
+		const int32 numInstances = meshComponent->GetInstanceCount();
+		if (numInstances < numVisible)
+		{
+			hiddenTransforms.Init(hiddenTransform, FMath::RoundUpToPowerOfTwo(numVisible) - numInstances);
+			meshComponent->AddInstances(hiddenTransforms, false, true);
+		}
+
+		// Instances freed since the last frame are hidden with the same batch
+		for (int32 k = numVisible; k < numUpdated; ++k)
+			transforms.Add(hiddenTransform);
+
+		meshComponent->BatchUpdateInstancesTransforms(0, transforms, true, true, true);
+	}
+}
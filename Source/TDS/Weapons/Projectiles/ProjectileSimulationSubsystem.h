@@ -0,0 +1,92 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CollisionQueryParams.h"
+#include "Engine/EngineTypes.h"
+#include "WorldCollision.h"
+
+#include "../../FuncLibrary/Types.h"
+#include "../../Game/TDSTickableWorldSubsystem.h"
+#include "ProjectileSimulationSubsystem.generated.h"
+
+class AProjectile_Base;
+class UInstancedStaticMeshComponent;
+
+// Everything the simulation takes from the projectile class, read once from its default object
+struct FSimulatedProjectileType
+{
+	int32 meshComponentIndex = INDEX_NONE;
+	FTransform meshTransform = FTransform::Identity;
+	float gravityZ = 0.f;
+	float collisionRadius = 0.f;
+	ECollisionChannel collisionChannel = ECC_WorldDynamic;
+	FCollisionResponseParams collisionResponse;
+};
+
+// Projectiles without actors: all rounds in flight live in flat arrays and are moved in one pass per frame.
+// The moves of a frame are swept by async traces and their hits are applied at the start of the next frame.
+// Every mesh keeps a pool of instances that only grows, free instances are scaled to zero
+UCLASS()
+class TDS_API UProjectileSimulationSubsystem : public UTDSTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	void AddProjectile(const FProjectileInfo& projectileInfo, const FVector& location, const FVector& direction, APawn* newInstigator);
+	// Shots fired earlier in the frame start further along their way
+	void AddProjectiles(const FProjectileInfo& projectileInfo, const TArray<FWeaponShot>& shots, APawn* newInstigator);
+
+	UFUNCTION(BlueprintCallable)
+	int32 GetNumProjectiles() const;
+
+private:
+	int32 FindOrAddProjectileType(UClass* projectileClass);
+	int32 FindOrAddMeshComponent(UStaticMesh* mesh);
+
+	// Hits of the sweeps of the last frame and the projectiles at the end of their life
+	void ApplySweepHits();
+	void MoveProjectiles(float DeltaTime);
+	void SweepProjectiles();
+	void OnSweepCompleted(const FTraceHandle& traceHandle, FTraceDatum& traceDatum);
+	void RemoveProjectile(int32 index);
+	void UpdateInstances();
+
+	// ======================== Projectiles in flight ========================
+	TArray<FVector> positions;
+	TArray<FVector> previousPositions;
+	TArray<FVector> velocities;
+	TArray<float> lifeTimes;
+	// OuterRadius is 0 if the projectile is not a bomb
+	TArray<FRadialDamageParams> damageParams;
+	TArray<int32> typeIndices;
+	TArray<TWeakObjectPtr<APawn>> instigators;
+	// User data of the async sweep, indices change with RemoveAtSwap
+	TArray<uint32> projectileIds;
+	uint32 nextProjectileId = 1;
+
+	FTraceDelegate sweepDelegate;
+	TMap<uint32, FHitResult> sweepHits;
+
+	// ================================ Types ================================
+	TArray<FSimulatedProjectileType> projectileTypes;
+	TMap<UClass*, int32> typeIndexByClass;
+
+	// ================================ Render ===============================
+	UPROPERTY()
+	AActor* renderActor = nullptr;
+	UPROPERTY()
+	TArray<UInstancedStaticMeshComponent*> meshComponents;
+	TArray<TArray<FTransform>> instanceTransforms;
+	// Instances shown in the last frame per mesh, the ones no longer used are hidden once
+	TArray<int32> visibleInstances;
+	TArray<FTransform> hiddenTransforms;
+	bool bIsInstancesVisible = false;
+};
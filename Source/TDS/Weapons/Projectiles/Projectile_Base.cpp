@@ -4,12 +4,21 @@
 #include "Projectile_Base.h"
 #include "PhysicalMaterials/PhysicalMaterial.h"
 #include "Kismet/GameplayStatics.h"
+#include "TimerManager.h"
+#include "GameFramework/Controller.h"
+#include "GameFramework/DamageType.h"
+
+#include "ProjectilePoolSubsystem.h"
+#include "../RadialDamageSubsystem.h"
+#include "../DamageSubsystem.h"
+#include "../../Game/SignificanceSubsystem.h"
+#include "../../TDSStats.h"
 
 // Sets default values
 AProjectile_Base::AProjectile_Base()
 {
-	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = true;
+	// Movement is done by the projectile movement component, the actor itself has nothing to tick
+	PrimaryActorTick.bCanEverTick = false;
 
 	bulletCollisionSphere = CreateDefaultSubobject<USphereComponent>(TEXT("Collision Sphere"));
 
@@ -48,26 +57,93 @@ void AProjectile_Base::BeginPlay()
 	bulletCollisionSphere->OnComponentHit.AddDynamic(this, &AProjectile_Base::BulletCollisionSphereHit);
 	bulletCollisionSphere->OnComponentBeginOverlap.AddDynamic(this, &AProjectile_Base::BulletCollisionSphereBeginOverlap);
 	bulletCollisionSphere->OnComponentEndOverlap.AddDynamic(this, &AProjectile_Base::BulletCollisionSphereEndOverlap);
-}
 
-// Called every frame
-void AProjectile_Base::Tick(float DeltaTime)
-{
-	Super::Tick(DeltaTime);
+	// Trail of the projectile loses its detail emitters away from the camera
+	USignificanceSubsystem* mySignificance = GetWorld()->GetSubsystem<USignificanceSubsystem>();
+	if (mySignificance)
+		mySignificance->RegisterActor(this, ESignificanceCategory::PROJECTILE);
 }
 
-void AProjectile_Base::InitProjectile(FProjectileInfo initParam)
+void AProjectile_Base::InitProjectile(const FProjectileInfo& initParam)
 {
 	bulletProjectileMovement->InitialSpeed = initParam.projectileInitSpeed;
 	bulletProjectileMovement->MaxSpeed = initParam.projectileInitSpeed;
-	this->SetLifeSpan(initParam.projectileLifeTime);
+
+	// Life span would destroy the actor, pooled projectile must come back to the pool instead
+	GetWorldTimerManager().ClearTimer(timerToLifeTime);
+	if (initParam.projectileLifeTime > 0.f)
+		GetWorldTimerManager().SetTimer(timerToLifeTime, this, &AProjectile_Base::LifeTimeExpired, initParam.projectileLifeTime, false);
 
 	projectileSetting = initParam;
 }
 
+// ================================== Pool ==================================
+void AProjectile_Base::ActivateProjectile(const FVector& location, const FRotator& rotation)
+{
+	SetActorLocationAndRotation(location, rotation, false, nullptr, ETeleportType::ResetPhysics);
+	SetActorHiddenInGame(false);
+	SetActorEnableCollision(true);
+
+	// Movement component drops the updated component when it stops simulating
+	bulletProjectileMovement->SetUpdatedComponent(RootComponent);
+	bulletProjectileMovement->Velocity = rotation.Vector() * bulletProjectileMovement->InitialSpeed;
+	bulletProjectileMovement->Activate(true);
+
+	if (bulletFX)
+		bulletFX->Activate(true);
+
+	bIsProjectileActive = true;
+}
+
+void AProjectile_Base::DeactivateProjectile()
+{
+	GetWorldTimerManager().ClearTimer(timerToLifeTime);
+
+	bulletProjectileMovement->StopMovementImmediately();
+	bulletProjectileMovement->Deactivate();
+
+	if (bulletFX)
+		bulletFX->DeactivateImmediate();
+
+	SetActorHiddenInGame(true);
+	SetActorEnableCollision(false);
+
+	bIsProjectileActive = false;
+}
+
+bool AProjectile_Base::IsProjectileActive() const
+{ return bIsProjectileActive; }
+
+void AProjectile_Base::LifeTimeExpired()
+{ ReturnProjectile(); }
+
+void AProjectile_Base::ReturnProjectile()
+{
+	UProjectilePoolSubsystem* myPool = GetWorld()->GetSubsystem<UProjectilePoolSubsystem>();
+
+	if (myPool)
+		myPool->ReleaseProjectile(this);
+	else
+		this->Destroy();
+}
+
 void AProjectile_Base::BulletCollisionSphereHit(UPrimitiveComponent* HitComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit)
 {
-	
+	if (!bIsProjectileActive)
+		return;
+
+	// Bombs deal their damage in ImpactProjectile, clients only show the hit
+	if (!projectileSetting.bIsLikeBomp && OtherActor && GetWorld()->GetNetMode() != NM_Client)
+	{
+		APawn* myInstigator = GetInstigator();
+		AController* instigatorController = myInstigator ? myInstigator->GetController() : nullptr;
+
+		UDamageSubsystem* myDamage = GetWorld()->GetSubsystem<UDamageSubsystem>();
+		if (!myDamage || !myDamage->QueueDamage(OtherActor, projectileSetting.projectileDamage, Hit.BoneName, instigatorController))
+			UGameplayStatics::ApplyPointDamage(OtherActor, projectileSetting.projectileDamage, GetVelocity().GetSafeNormal(), Hit, instigatorController, this, UDamageType::StaticClass());
+	}
+
+	ImpactProjectile();
 }
 
 void AProjectile_Base::BulletCollisionSphereBeginOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
@@ -80,5 +156,14 @@ void AProjectile_Base::BulletCollisionSphereEndOverlap(UPrimitiveComponent* Over
 
 void AProjectile_Base::ImpactProjectile()
 {
-	this->Destroy();
+	TDS_SCOPE_CYCLE_COUNTER(ProjectileHit);
+
+	if (projectileSetting.bIsLikeBomp)
+	{
+		URadialDamageSubsystem* myRadialDamage = GetWorld()->GetSubsystem<URadialDamageSubsystem>();
+		if (myRadialDamage)
+			myRadialDamage->QueueProjectileExplosion(projectileSetting, GetActorLocation(), this, GetInstigator());
+	}
+
+	ReturnProjectile();
 }
@@ -29,6 +29,7 @@ public:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"), Category = Components)
 	class UParticleSystemComponent* bulletFX = nullptr;
 
+	// Copy of the weapon settings, a pooled projectile outlives a reimport of the weapon table
 	FProjectileInfo projectileSetting;
 
 protected:
@@ -36,10 +37,12 @@ protected:
 	virtual void BeginPlay() override;
 
 public:
-	// Called every frame
-	virtual void Tick(float DeltaTime) override;
+	void InitProjectile(const FProjectileInfo& initParam);
 
-	void InitProjectile(FProjectileInfo initParam);
+	// ================================== Pool ==================================
+	void ActivateProjectile(const FVector& location, const FRotator& rotation);
+	void DeactivateProjectile();
+	bool IsProjectileActive() const;
 
 	UFUNCTION()
 	void BulletCollisionSphereHit(class UPrimitiveComponent* HitComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit);
@@ -50,4 +53,14 @@ public:
 
 	UFUNCTION()
 	virtual void ImpactProjectile();
+
+private:
+	UFUNCTION()
+	void LifeTimeExpired();
+	// Gives the projectile back to the pool (or destroys it if there is no pool)
+	void ReturnProjectile();
+
+	UPROPERTY()
+	FTimerHandle timerToLifeTime;
+	bool bIsProjectileActive = false;
 };
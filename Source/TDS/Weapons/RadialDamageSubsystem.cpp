@@ -0,0 +1,273 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "RadialDamageSubsystem.h"
+#include "Engine/World.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/Controller.h"
+#include "GameFramework/DamageType.h"
+#include "Components/PrimitiveComponent.h"
+
+#include "DamageSubsystem.h"
+#include "../TDSStats.h"
+
+void URadialDamageSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	traceDelegate.BindUObject(this, &URadialDamageSubsystem::OnTraceCompleted);
+}
+
+void URadialDamageSubsystem::Deinitialize()
+{
+	traceDelegate.Unbind();
+	damageTargets.Empty();
+	queuedExplosions.Empty();
+	targetLocations.Empty();
+	targetRadiuses.Empty();
+	sortedTargets.Empty();
+	cellRanges.Empty();
+	gridTargets.Empty();
+	overlaps.Empty();
+	overlapActors.Empty();
+	frameHits.Empty();
+	pendingHits.Empty();
+
+	Super::Deinitialize();
+}
+
+TStatId URadialDamageSubsystem::GetStatId() const
+{ RETURN_QUICK_DECLARE_CYCLE_STAT(URadialDamageSubsystem, STATGROUP_Tickables); }
+
+void URadialDamageSubsystem::Tick(float DeltaTime)
+{
+	if (queuedExplosions.Num() == 0)
+		return;
+
+	TDS_SCOPE_CYCLE_COUNTER(RadialDamage);
+
+	// One grid for the whole salvo
+	BuildGrid();
+
+	frameHits.Reset();
+	for (const FRadialExplosion& explosion : queuedExplosions)
+	{
+		QueryGrid(explosion);
+		if (bOverlapUnregisteredTargets)
+			QueryOverlaps(explosion);
+	}
+	queuedExplosions.Reset();
+
+	UWorld* world = GetWorld();
+	for (const FRadialDamageHit& radialHit : frameHits)
+	{
+		if (!bCheckOcclusion)
+		{
+			ApplyRadialHit(radialHit);
+			continue;
+		}
+
+		FCollisionQueryParams queryParams(SCENE_QUERY_STAT(RadialDamageOcclusion), false);
+		queryParams.AddIgnoredActor(radialHit.explosion.damageCauser.Get());
+
+		TDS_INC_COUNTER(TracesIssued, 1);
+
+		const uint32 hitId = nextHitId++;
+		pendingHits.Add(hitId, radialHit);
+		world->AsyncLineTraceByChannel(EAsyncTraceType::Single, radialHit.explosion.origin, radialHit.hitLocation, occlusionChannel,
+			queryParams, FCollisionResponseParams::DefaultResponseParam, &traceDelegate, hitId);
+	}
+	frameHits.Reset();
+}
+
+void URadialDamageSubsystem::RegisterDamageTarget(AActor* target)
+{
+	if (target)
+		damageTargets.AddUnique(target);
+}
+
+void URadialDamageSubsystem::UnregisterDamageTarget(AActor* target)
+{ damageTargets.RemoveSwap(target); }
+
+void URadialDamageSubsystem::QueueExplosion(const FVector& origin, const FRadialDamageParams& damageParams, AActor* damageCauser, AController* instigatorController)
+{
+	// Explosions replayed on clients are only visible
+	if (damageParams.OuterRadius <= 0.f || GetWorld()->GetNetMode() == NM_Client)
+		return;
+
+	FRadialExplosion& newExplosion = queuedExplosions.AddDefaulted_GetRef();
+	newExplosion.origin = origin;
+	newExplosion.damageParams = damageParams;
+	newExplosion.damageCauser = damageCauser;
+	newExplosion.instigatorController = instigatorController;
+}
+
+void URadialDamageSubsystem::QueueProjectileExplosion(const FProjectileInfo& projectileInfo, const FVector& origin, AActor* damageCauser, APawn* newInstigator)
+{ QueueExplosion(origin, MakeDamageParams(projectileInfo), damageCauser, newInstigator ? newInstigator->GetController() : nullptr); }
+
+FRadialDamageParams URadialDamageSubsystem::MakeDamageParams(const FProjectileInfo& projectileInfo)
+{
+	FRadialDamageParams damageParams(projectileInfo.projectileDamage, projectileInfo.projectileMinDamage,
+		projectileInfo.projectileMinRadiusDamage, projectileInfo.projectileMaxRadiusDamage, projectileInfo.projectileDamageFalloff);
+
+	if (!projectileInfo.bIsLikeBomp)
+		damageParams.OuterRadius = 0.f;
+
+	return damageParams;
+}
+
+int32 URadialDamageSubsystem::GetNumDamageTargets() const
+{ return damageTargets.Num(); }
+
+// ================================ Grid ================================
+void URadialDamageSubsystem::BuildGrid()
+{
+	targetLocations.Reset();
+	targetRadiuses.Reset();
+	sortedTargets.Reset();
+	cellRanges.Reset();
+	gridTargets.Reset();
+	maxTargetRadius = 0.f;
+
+	// Backwards so RemoveAtSwap only brings in targets which are already checked
+	for (int32 i = damageTargets.Num() - 1; i >= 0; --i)
+		if (!damageTargets[i].IsValid())
+			damageTargets.RemoveAtSwap(i, 1, false);
+
+	TArray<FIntPoint> targetCells;
+	targetCells.Reserve(damageTargets.Num());
+
+	for (int32 i = 0; i < damageTargets.Num(); ++i)
+	{
+		const AActor* target = damageTargets[i].Get();
+		const float targetRadius = target->GetSimpleCollisionRadius();
+
+		gridTargets.Add(target);
+		targetLocations.Add(target->GetActorLocation());
+		targetRadiuses.Add(targetRadius);
+		targetCells.Add(GetCell(targetLocations[i]));
+		sortedTargets.Add(i);
+		maxTargetRadius = FMath::Max(maxTargetRadius, targetRadius);
+	}
+
+	sortedTargets.Sort([&targetCells](int32 a, int32 b)
+	{
+		return targetCells[a].X != targetCells[b].X ? targetCells[a].X < targetCells[b].X : targetCells[a].Y < targetCells[b].Y;
+	});
+
+	for (int32 i = 0; i < sortedTargets.Num(); ++i)
+	{
+		const FIntPoint& targetCell = targetCells[sortedTargets[i]];
+		FIntPoint* cellRange = cellRanges.Find(targetCell);
+		if (!cellRange)
+			cellRange = &cellRanges.Add(targetCell, FIntPoint(i, 0));
+		cellRange->Y++;
+	}
+}
+
+void URadialDamageSubsystem::QueryGrid(const FRadialExplosion& explosion)
+{
+	const float searchRadius = explosion.damageParams.OuterRadius + maxTargetRadius;
+	const FIntPoint minCell = GetCell(explosion.origin - FVector(searchRadius));
+	const FIntPoint maxCell = GetCell(explosion.origin + FVector(searchRadius));
+
+	for (int32 x = minCell.X; x <= maxCell.X; ++x)
+		for (int32 y = minCell.Y; y <= maxCell.Y; ++y)
+		{
+			const FIntPoint* cellRange = cellRanges.Find(FIntPoint(x, y));
+			if (!cellRange)
+				continue;
+
+			for (int32 i = cellRange->X; i < cellRange->X + cellRange->Y; ++i)
+			{
+				const int32 targetIndex = sortedTargets[i];
+				AddHit(explosion, damageTargets[targetIndex].Get(), targetLocations[targetIndex], targetRadiuses[targetIndex]);
+			}
+		}
+}
+
+void URadialDamageSubsystem::QueryOverlaps(const FRadialExplosion& explosion)
+{
+	FCollisionQueryParams queryParams(SCENE_QUERY_STAT(RadialDamageOverlap), false);
+	queryParams.AddIgnoredActor(explosion.damageCauser.Get());
+
+	// Same objects as UGameplayStatics::ApplyRadialDamage
+	overlaps.Reset();
+	GetWorld()->OverlapMultiByObjectType(overlaps, explosion.origin, FQuat::Identity,
+		FCollisionObjectQueryParams(FCollisionObjectQueryParams::InitType::AllDynamicObjects),
+		FCollisionShape::MakeSphere(explosion.damageParams.OuterRadius), queryParams);
+
+	// One hit per actor, not per component
+	overlapActors.Reset();
+	for (const FOverlapResult& overlap : overlaps)
+	{
+		AActor* target = overlap.GetActor();
+		if (!target || !target->CanBeDamaged() || gridTargets.Contains(target) || overlapActors.Contains(target))
+			continue;
+
+		overlapActors.Add(target);
+		AddHit(explosion, target, target->GetActorLocation(), target->GetSimpleCollisionRadius());
+	}
+}
+
+void URadialDamageSubsystem::AddHit(const FRadialExplosion& explosion, AActor* target, const FVector& targetLocation, float targetRadius)
+{
+	const FVector toTarget = targetLocation - explosion.origin;
+	const float distance = FMath::Max(toTarget.Size() - targetRadius, 0.f);
+
+	if (distance > explosion.damageParams.OuterRadius)
+		return;
+
+	FRadialDamageHit& newHit = frameHits.AddDefaulted_GetRef();
+	newHit.explosion = explosion;
+	newHit.target = target;
+	// Closest point of the target, the engine scales the damage by the distance to it
+	newHit.hitLocation = explosion.origin + toTarget.GetSafeNormal() * distance;
+}
+
+FIntPoint URadialDamageSubsystem::GetCell(const FVector& location) const
+{
+	const float mySize = FMath::Max(cellSize, 1.f);
+	return FIntPoint(FMath::FloorToInt(location.X / mySize), FMath::FloorToInt(location.Y / mySize));
+}
+
+// ================================ Damage ================================
+void URadialDamageSubsystem::OnTraceCompleted(const FTraceHandle& traceHandle, FTraceDatum& traceDatum)
+{
+	FRadialDamageHit radialHit;
+	if (!pendingHits.RemoveAndCopyValue(traceDatum.UserData, radialHit))
+		return;
+
+	for (const FHitResult& hitResult : traceDatum.OutHits)
+		if (hitResult.bBlockingHit && hitResult.GetActor() != radialHit.target.Get())
+			return;
+
+	ApplyRadialHit(radialHit);
+}
+
+void URadialDamageSubsystem::ApplyRadialHit(const FRadialDamageHit& radialHit)
+{
+	AActor* target = radialHit.target.Get();
+	if (!IsValid(target))
+		return;
+
+	// Falloff of AActor::InternalTakeRadialDamage, the queued hit is already scaled
+	const FRadialDamageParams& damageParams = radialHit.explosion.damageParams;
+	const float damageScale = damageParams.GetDamageScale(FVector::Dist(radialHit.hitLocation, radialHit.explosion.origin));
+	const float damage = FMath::Lerp(damageParams.MinimumDamage, damageParams.BaseDamage, FMath::Max(damageScale, 0.f));
+
+	UDamageSubsystem* myDamage = GetWorld()->GetSubsystem<UDamageSubsystem>();
+	if (myDamage && myDamage->QueueDamage(target, damage, NAME_None, radialHit.explosion.instigatorController.Get()))
+		return;
+
+	const FVector hitDirection = (radialHit.hitLocation - radialHit.explosion.origin).GetSafeNormal();
+
+	// Same event ApplyRadialDamageWithFalloff builds, the target scales the damage by the distance to its hit
+	FRadialDamageEvent damageEvent;
+	damageEvent.DamageTypeClass = UDamageType::StaticClass();
+	damageEvent.Origin = radialHit.explosion.origin;
+	damageEvent.Params = radialHit.explosion.damageParams;
+	damageEvent.ComponentHits.Add(FHitResult(target, Cast<UPrimitiveComponent>(target->GetRootComponent()), radialHit.hitLocation, -hitDirection));
+
+	target->TakeDamage(damageEvent.Params.BaseDamage, damageEvent, radialHit.explosion.instigatorController.Get(), radialHit.explosion.damageCauser.Get());
+}
@@ -0,0 +1,103 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineTypes.h"
+#include "WorldCollision.h"
+
+#include "../FuncLibrary/Types.h"
+#include "../Game/TDSTickableWorldSubsystem.h"
+#include "RadialDamageSubsystem.generated.h"
+
+struct FRadialExplosion
+{
+	FVector origin = FVector::ZeroVector;
+	FRadialDamageParams damageParams;
+	TWeakObjectPtr<AActor> damageCauser;
+	TWeakObjectPtr<AController> instigatorController;
+};
+
+// Explosion reached the target, damage is applied if nothing stands between them
+struct FRadialDamageHit
+{
+	FRadialExplosion explosion;
+	TWeakObjectPtr<AActor> target;
+	FVector hitLocation = FVector::ZeroVector;
+};
+
+// Explosions are queued during the frame and resolved together: damage targets are put in a uniform grid once,
+// every explosion only looks at the cells under its radius, and occlusion is checked by async traces.
+// Actors with a UHealthComponent register themselves, other damageable actors are found by an overlap like ApplyRadialDamage does
+UCLASS(Config = Game)
+class TDS_API URadialDamageSubsystem : public UTDSTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// Size of the grid cell in XY, about the radius of a usual explosion
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "Radial damage")
+	float cellSize = 500.f;
+	// Walls between the explosion and the target block the damage
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "Radial damage")
+	bool bCheckOcclusion = true;
+	// Pawns don't block Visibility, so one pawn does not shield another
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "Radial damage")
+	TEnumAsByte<ECollisionChannel> occlusionChannel = ECC_Visibility;
+	// Props and pawns without a health component, one overlap of the dynamic objects per explosion
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "Radial damage")
+	bool bOverlapUnregisteredTargets = true;
+
+	// Registered actors are found through the grid without an overlap
+	UFUNCTION(BlueprintCallable)
+	void RegisterDamageTarget(AActor* target);
+	UFUNCTION(BlueprintCallable)
+	void UnregisterDamageTarget(AActor* target);
+
+	void QueueExplosion(const FVector& origin, const FRadialDamageParams& damageParams, AActor* damageCauser, AController* instigatorController);
+	void QueueProjectileExplosion(const FProjectileInfo& projectileInfo, const FVector& origin, AActor* damageCauser, APawn* newInstigator);
+
+	static FRadialDamageParams MakeDamageParams(const FProjectileInfo& projectileInfo);
+
+	UFUNCTION(BlueprintCallable)
+	int32 GetNumDamageTargets() const;
+
+private:
+	void BuildGrid();
+	void QueryGrid(const FRadialExplosion& explosion);
+	void QueryOverlaps(const FRadialExplosion& explosion);
+	void AddHit(const FRadialExplosion& explosion, AActor* target, const FVector& targetLocation, float targetRadius);
+	FIntPoint GetCell(const FVector& location) const;
+
+	void OnTraceCompleted(const FTraceHandle& traceHandle, FTraceDatum& traceDatum);
+	void ApplyRadialHit(const FRadialDamageHit& radialHit);
+
+	TArray<TWeakObjectPtr<AActor>> damageTargets;
+	TArray<FRadialExplosion> queuedExplosions;
+
+	// ================================ Grid ================================
+	// Rebuilt only in frames with explosions, targets are sorted by cell and every cell is a range of them
+	TArray<FVector> targetLocations;
+	TArray<float> targetRadiuses;
+	TArray<int32> sortedTargets;
+	TMap<FIntPoint, FIntPoint> cellRanges;
+	float maxTargetRadius = 0.f;
+	// Registered targets are skipped by the overlap
+	TSet<const AActor*> gridTargets;
+
+	TArray<FOverlapResult> overlaps;
+	TSet<const AActor*> overlapActors;
+
+	// Hits of this frame, applied directly or after their traces
+	TArray<FRadialDamageHit> frameHits;
+
+	FTraceDelegate traceDelegate;
+	TMap<uint32, FRadialDamageHit> pendingHits;
+	uint32 nextHitId = 1;
+};
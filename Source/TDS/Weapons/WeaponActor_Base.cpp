@@ -2,12 +2,33 @@
 
 
 #include "WeaponActor_Base.h"
+#include "Engine/World.h"
+#include "Engine/GameInstance.h"
+#include "Engine/StaticMesh.h"
+#include "GameFramework/Character.h"
+#include "Components/CapsuleComponent.h"
+#include "GameFramework/GameStateBase.h"
+
+#include "Projectiles/ProjectilePoolSubsystem.h"
+#include "Projectiles/ProjectileSimulationSubsystem.h"
+#include "WeaponTraceSubsystem.h"
+#include "WeaponTickSubsystem.h"
+#include "FXPoolSubsystem.h"
+#include "WeaponDebrisSubsystem.h"
+#include "../Game/WeaponRegistrySubsystem.h"
+#include "../Game/SignificanceSubsystem.h"
+#include "../Character/TDSCharacter.h"
+#include "../TDSStats.h"
+#include "../TDS.h"
+
+// Replayed shots older than this are moved no further, the rest of the delay is left visible
+static const float maxReplayLatency = 0.25f;
 
 // Sets default values
 AWeaponActor_Base::AWeaponActor_Base()
 {
-	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = true;
+	// Timers are advanced by UWeaponTickSubsystem together with all other weapons
+	PrimaryActorTick.bCanEverTick = false;
 
 	sceneComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Scene"));
 	RootComponent = sceneComponent;
@@ -24,50 +45,33 @@ AWeaponActor_Base::AWeaponActor_Base()
 
 	shootLocation = CreateDefaultSubobject<UArrowComponent>(TEXT("ShootLocation"));
 	shootLocation->SetupAttachment(RootComponent);
+
+	sleeveLocation = CreateDefaultSubobject<UArrowComponent>(TEXT("SleeveLocation"));
+	sleeveLocation->SetupAttachment(RootComponent);
 }
 
 // Called when the game starts or when spawned
 void AWeaponActor_Base::BeginPlay()
 {
 	Super::BeginPlay();
-}
 
-// Called every frame
-void AWeaponActor_Base::Tick(float DeltaTime)
-{
-	Super::Tick(DeltaTime);
+	UWeaponTickSubsystem* myTick = GetTickSubsystem();
+	if (myTick)
+		tickSlot = myTick->RegisterWeapon(this, weaponInfo.round);
 
-	FireTick(DeltaTime);
-	ReloadTick(DeltaTime);
+	USignificanceSubsystem* mySignificance = GetWorld()->GetSubsystem<USignificanceSubsystem>();
+	if (mySignificance)
+		mySignificance->RegisterActor(this, ESignificanceCategory::WEAPON);
 }
 
-void AWeaponActor_Base::FireTick(float DeltaTime)
+void AWeaponActor_Base::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
-	if (weaponFiring)
-		if (fireTimer < 0.f)
-		{
-			if (GetWeaponRound() > 0)
-			{
-				if (!weaponReloading)
-					Fire();
-			}
-			else
-			{
-				if (!weaponReloading)
-					InitReload();
-			}
-		}
-		else
-			fireTimer -= DeltaTime;
-}
+	UWeaponTickSubsystem* myTick = GetTickSubsystem();
+	if (myTick && tickSlot != INDEX_NONE)
+		myTick->UnregisterWeapon(tickSlot);
+	tickSlot = INDEX_NONE;
 
-void AWeaponActor_Base::ReloadTick(float DeltaTime)
-{
-	if (weaponReloading)
-		if (reloadTimer < 0.f)
-			FinishReload();
-		else
-			reloadTimer -= DeltaTime;
+	Super::EndPlay(EndPlayReason);
 }
 
 void AWeaponActor_Base::WeaponInit()
@@ -85,82 +89,331 @@ void AWeaponActor_Base::WeaponInit()
 
 void AWeaponActor_Base::SetWeaponStateFire(bool bIsFire)
 {
-	if (CheckWeaponCanFire())
-		weaponFiring = bIsFire;
-	else
-		weaponFiring = false;
+	UWeaponTickSubsystem* myTick = GetTickSubsystem();
+	if (myTick)
+		myTick->SetTriggerHeld(tickSlot, bIsFire && CheckWeaponCanFire());
 }
 
 bool AWeaponActor_Base::CheckWeaponCanFire()
 { return true; }
 
-FProjectileInfo AWeaponActor_Base::GetProjectile()
-{ return weaponSettings.projectileSettings; }
+const FProjectileInfo& AWeaponActor_Base::GetProjectile() const
+{ return GetWeaponSettings().projectileSettings; }
 
-void AWeaponActor_Base::Fire()
+void AWeaponActor_Base::FireBatch(const TArray<FWeaponShot>& shots)
 {
-	fireTimer = weaponSettings.rateOfFire;
-	weaponInfo.round--;
+	if (shots.Num() == 0)
+		return;
 
-	if (shootLocation)
-	{
-		FVector spawnLocation = shootLocation->GetComponentLocation();
-		FRotator spawnRotation = shootLocation->GetComponentRotation();
-		FProjectileInfo ProjectileInfo;
-		ProjectileInfo = GetProjectile();
+	const FProjectileInfo& ProjectileInfo = GetProjectile();
 
-		if (ProjectileInfo.projectile)
+	if (ProjectileInfo.projectile)
+	{
+		//Projectile Init ballistic fire
+		if (ProjectileInfo.bIsSimulated)
 		{
-			//Projectile Init ballistic fire
-
-			FActorSpawnParameters spawnParams;
-			spawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
-			spawnParams.Owner = GetOwner();
-			spawnParams.Instigator = GetInstigator();
-
-			AProjectile_Base* myProjectile = Cast<AProjectile_Base>(GetWorld()->SpawnActor(ProjectileInfo.projectile, &spawnLocation, &spawnRotation, spawnParams));
-			if (myProjectile)
-			{
-				//ToDo Init Projectile settings by id in table row(or keep in weapon table)
-				myProjectile->InitialLifeSpan = 20.f;
-				//Projectile->BulletProjectileMovement->InitialSpeed = 2500.0f;
-			}
+			UProjectileSimulationSubsystem* mySimulation = GetWorld()->GetSubsystem<UProjectileSimulationSubsystem>();
+			if (mySimulation)
+				mySimulation->AddProjectiles(ProjectileInfo, shots, GetInstigator());
 		}
 		else
 		{
-			//ToDo Projectile null Init trace fire
+			UProjectilePoolSubsystem* myPool = GetWorld()->GetSubsystem<UProjectilePoolSubsystem>();
+			if (myPool)
+				for (const FWeaponShot& shot : shots)
+				{
+					// Round fired earlier in the frame has already flown a part of its way
+					const FVector spawnLocation = shot.location + shot.direction * ProjectileInfo.projectileInitSpeed * shot.timeOffset;
+					myPool->AcquireProjectile(ProjectileInfo, spawnLocation, shot.direction.Rotation(), GetOwner(), GetInstigator());
+				}
 		}
 	}
+	else
+	{
+		// Projectile null - trace fire
+		// Server hits the targets where the shooter saw them
+		const ATDSCharacter* myCharacter = Cast<ATDSCharacter>(GetInstigator());
+		const float viewTime = GetWorld()->GetTimeSeconds() - (myCharacter ? myCharacter->GetLagCompensationDelay() : 0.f);
 
+		UWeaponTraceSubsystem* myTrace = GetWorld()->GetSubsystem<UWeaponTraceSubsystem>();
+		if (myTrace)
+			myTrace->QueueTraceShots(GetWeaponSettings(), shots, this, GetInstigator(), viewTime);
+	}
 }
 
 void AWeaponActor_Base::UpdateStateWeapon(EMovementState NewMovementState)
 {
-	//ToDo Dispersion
+	dispersionMovementState = NewMovementState;
 	ChangeDispersion();
 }
 
 void AWeaponActor_Base::ChangeDispersion()
 {
+	const float currentTime = GetWorld() ? GetWorld()->GetTimeSeconds() : 0.f;
+	const float currentDispersion = GetDispersionAt(currentTime);
 
+	dispersionState = GetWeaponSettings().dispersionWeapon.GetDispersionState(dispersionMovementState);
+	dispersion = FMath::Clamp(currentDispersion, dispersionState.min, dispersionState.max);
+	dispersionTime = currentTime;
+}
+
+void AWeaponActor_Base::SetDispersionSeed(int32 newSeed)
+{
+	dispersionSeed = newSeed;
+	shotCounter = 0;
+}
+
+float AWeaponActor_Base::GetCurrentDispersion() const
+{ return GetDispersionAt(GetWorld() ? GetWorld()->GetTimeSeconds() : 0.f); }
+
+FVector AWeaponActor_Base::GetShotDirection(const FVector& forward, const FVector& right, const FVector& up, float shotTime)
+{
+	const float shotDispersion = GetDispersionAt(shotTime);
+
+	dispersion = FMath::Min(shotDispersion + dispersionState.shootCoef, dispersionState.max);
+	dispersionTime = shotTime;
+
+	const TArray<FVector2D>* dispersionTable = weaponRegistry ? weaponRegistry->GetDispersionTable(weaponHandle) : nullptr;
+	if (!dispersionTable || dispersionTable->Num() == 0)
+		return forward;
+
+	// Table size is a power of two
+	const FVector2D& sample = (*dispersionTable)[(dispersionSeed + shotCounter++) & (dispersionTable->Num() - 1)];
+
+	// Spread stays within a few degrees, tan(angle) is the angle itself there
+	const float spread = FMath::DegreesToRadians(shotDispersion);
+	return (forward + (right * sample.X + up * sample.Y) * spread).GetSafeNormal();
+}
+
+float AWeaponActor_Base::GetDispersionAt(float time) const
+{
+	const float recovery = GetWeaponSettings().dispersionWeapon.dispersionRecovery * FMath::Max(time - dispersionTime, 0.f);
+	return FMath::Max(dispersion - recovery, dispersionState.min);
 }
 
 void AWeaponActor_Base::InitReload()
 {
-	weaponReloading = true;
+	UWeaponTickSubsystem* myTick = GetTickSubsystem();
+	if (myTick)
+		myTick->StartReload(tickSlot);
 	// ToDo anim reload
 }
 
-void AWeaponActor_Base::FinishReload()
+// ============================ UWeaponTickSubsystem ============================
+void AWeaponActor_Base::OnWeaponFired(int32 numShots, float firstShotOffset, float fireInterval, int32 newRound)
+{
+	TDS_SCOPE_CYCLE_COUNTER(WeaponFire);
+	TDS_INC_COUNTER(ShotsFired, numShots);
+
+	weaponInfo.round = newRound;
+
+	if (!shootLocation)
+		return;
+
+	// Aim comes from the cursor query of the character, the muzzle bone moves with animations throttled by significance
+	ATDSCharacter* myCharacter = Cast<ATDSCharacter>(GetInstigator());
+
+	// Only a long hitch gets here, the oldest shots are moved up to what the batch can carry
+	if (firstShotOffset > FWeaponShotBatch::GetMaxFirstShotOffset())
+	{
+		UE_LOG(LogTDS, Warning, TEXT("%s: first shot was due %.3f s ago, sent as %.3f s"),
+			*GetName(), firstShotOffset, FWeaponShotBatch::GetMaxFirstShotOffset());
+	}
+
+	const ENetMode netMode = GetNetMode();
+	const FVector shotOrigin = shootLocation->GetComponentLocation();
+	const FVector shotDirection = myCharacter ? myCharacter->GetAimDirection() : shootLocation->GetForwardVector();
+	const float serverTime = GetServerWorldTime();
+
+	// More shots than one batch holds go out in several, oldest first
+	for (int32 firstShot = 0; firstShot < numShots; firstShot += FWeaponShotBatch::GetMaxShots())
+	{
+		const float batchOffset = FMath::Min(FMath::Max(firstShotOffset - firstShot * fireInterval, 0.f), FWeaponShotBatch::GetMaxFirstShotOffset());
+
+		FWeaponShotBatch shotBatch;
+		shotBatch.weaponHandle = weaponHandle;
+		shotBatch.origin = shotOrigin;
+		shotBatch.direction = shotDirection;
+		shotBatch.sampleIndex = dispersionSeed + shotCounter;
+		shotBatch.dispersion = GetDispersionAt(GetWorld()->GetTimeSeconds() - batchOffset);
+		shotBatch.movementState = dispersionMovementState;
+		shotBatch.numShots = uint8(FMath::Min(numShots - firstShot, FWeaponShotBatch::GetMaxShots()));
+		shotBatch.firstShotOffset = batchOffset;
+		shotBatch.timeStamp = serverTime;
+
+		PlayShotBatch(shotBatch, fireInterval, 0.f);
+
+		// Projectiles are never replicated, other machines replay the batch
+		if (myCharacter && (netMode == NM_ListenServer || netMode == NM_DedicatedServer))
+			myCharacter->MulticastShotBatch(shotBatch);
+	}
+}
+
+// ================================= Network =================================
+void AWeaponActor_Base::ReplayShotBatch(const FWeaponShotBatch& shotBatch)
 {
-	weaponReloading = false;
-	reloadTimer = weaponSettings.reloadTime;
-	weaponInfo.round = weaponSettings.maxRound;
+	// Weapon was switched while the batch was in flight
+	if (shotBatch.weaponHandle != weaponHandle)
+		return;
+
+	TDS_SCOPE_CYCLE_COUNTER(WeaponFire);
+
+	const float firstShotTime = GetWorld()->GetTimeSeconds() - shotBatch.firstShotOffset;
+
+	// Same cone, same samples as on the server
+	dispersionMovementState = shotBatch.movementState;
+	dispersionState = GetWeaponSettings().dispersionWeapon.GetDispersionState(dispersionMovementState);
+	dispersion = shotBatch.dispersion;
+	dispersionTime = firstShotTime;
+	shotCounter = shotBatch.sampleIndex - dispersionSeed;
+
+	const float latency = FMath::Clamp(GetServerWorldTime() - shotBatch.timeStamp, 0.f, maxReplayLatency);
+	PlayShotBatch(shotBatch, GetWeaponSettings().rateOfFire, latency);
+}
+
+void AWeaponActor_Base::PlayShotBatch(const FWeaponShotBatch& shotBatch, float fireInterval, float latency)
+{
+	// Spread axes come from the direction alone so every machine gets the same ones
+	const FRotationMatrix aimMatrix(shotBatch.direction.Rotation());
+	const FVector shotRight = aimMatrix.GetScaledAxis(EAxis::Y);
+	const FVector shotUp = aimMatrix.GetScaledAxis(EAxis::Z);
+	const float currentTime = GetWorld()->GetTimeSeconds();
+
+	// Every shot which was due during the tick (oldest first), each one with the time it should have been fired
+	pendingShots.Reset();
+	for (int32 i = 0; i < shotBatch.numShots; ++i)
+	{
+		FWeaponShot& newShot = pendingShots.AddDefaulted_GetRef();
+		newShot.location = shotBatch.origin;
+		newShot.timeOffset = FMath::Max(shotBatch.firstShotOffset - i * fireInterval, 0.f);
+		newShot.direction = GetShotDirection(shotBatch.direction, shotRight, shotUp, currentTime - newShot.timeOffset);
+		newShot.timeOffset += latency;
+	}
+
+	FireBatch(pendingShots);
+
+	// Shots are the same at any significance, only the looks are cut: no sleeves below high, no flash at low
+	const ESignificanceTier myTier = GetSignificanceTier();
+
+	// One flash for all shots of the tick
+	UFXPoolSubsystem* myFXPool = GetWorld()->GetSubsystem<UFXPoolSubsystem>();
+	if (myFXPool && pendingShots.Num() > 0 && myTier != ESignificanceTier::LOW)
+		myFXPool->SpawnEmitterAttached(GetWeaponSettings().effectFireWeapon.Get(), shootLocation);
+
+	UWeaponDebrisSubsystem* myDebris = GetWorld()->GetSubsystem<UWeaponDebrisSubsystem>();
+	UStaticMesh* sleeveMesh = GetWeaponSettings().sleeveBullets.Get();
+	if (myDebris && sleeveMesh && sleeveLocation && myTier == ESignificanceTier::HIGH)
+	{
+		const FVector sleeveStart = sleeveLocation->GetComponentLocation();
+		const FRotator sleeveRotation = sleeveLocation->GetComponentRotation();
+		const FVector sleeveDirection = sleeveLocation->GetForwardVector();
+		const float groundZ = GetGroundZ();
+
+		for (const FWeaponShot& shot : pendingShots)
+		{
+			const FVector sleeveVelocity = sleeveDirection * FMath::FRandRange(150.f, 250.f) + FVector(0.f, 0.f, FMath::FRandRange(150.f, 250.f));
+			myDebris->SpawnDebris(sleeveMesh, sleeveStart + sleeveVelocity * shot.timeOffset, sleeveRotation, sleeveVelocity, groundZ);
+		}
+	}
+}
+
+float AWeaponActor_Base::GetServerWorldTime() const
+{
+	const AGameStateBase* myGameState = GetWorld()->GetGameState();
+	return myGameState ? myGameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds();
+}
+
+void AWeaponActor_Base::OnReloadStarted()
+{
+	UWeaponDebrisSubsystem* myDebris = GetWorld()->GetSubsystem<UWeaponDebrisSubsystem>();
+	UStaticMesh* magazineMesh = GetWeaponSettings().magazineDrop.Get();
+	if (myDebris && magazineMesh && GetSignificanceTier() != ESignificanceTier::LOW)
+		myDebris->SpawnDebris(magazineMesh, GetActorLocation(), GetActorRotation(), FVector::ZeroVector, GetGroundZ());
+}
+
+ESignificanceTier AWeaponActor_Base::GetSignificanceTier() const
+{
+	const USignificanceSubsystem* mySignificance = GetWorld()->GetSubsystem<USignificanceSubsystem>();
+	return mySignificance ? mySignificance->GetActorTier(this) : ESignificanceTier::HIGH;
+}
+
+void AWeaponActor_Base::OnReloadFinished(int32 newRound)
+{
+	weaponInfo.round = newRound;
+}
+
+void AWeaponActor_Base::SetTickSlot(int32 newTickSlot)
+{ tickSlot = newTickSlot; }
+
+float AWeaponActor_Base::GetGroundZ() const
+{
+	const ACharacter* myCharacter = Cast<ACharacter>(GetInstigator());
+	if (myCharacter && myCharacter->GetCapsuleComponent())
+		return myCharacter->GetActorLocation().Z - myCharacter->GetCapsuleComponent()->GetScaledCapsuleHalfHeight();
+
+	return GetActorLocation().Z;
+}
+
+UWeaponTickSubsystem* AWeaponActor_Base::GetTickSubsystem() const
+{
+	UWorld* world = GetWorld();
+	return world ? world->GetSubsystem<UWeaponTickSubsystem>() : nullptr;
 }
 
 // ================================= Setters and Getters =================================
-void AWeaponActor_Base::SetWeaponSettings(FWeaponInfo newWeaponSettings)
-{ weaponSettings = newWeaponSettings; }
+void AWeaponActor_Base::SetWeaponDefinition(FWeaponHandle newWeaponHandle)
+{
+	UGameInstance* myGameInstance = GetGameInstance();
+	weaponRegistry = myGameInstance ? myGameInstance->GetSubsystem<UWeaponRegistrySubsystem>() : nullptr;
+	weaponHandle = newWeaponHandle;
+
+	const FWeaponInfo& weaponSettings = GetWeaponSettings();
+	UWeaponTickSubsystem* myTick = GetTickSubsystem();
+	if (myTick)
+		myTick->SetWeaponConfig(tickSlot, weaponSettings.rateOfFire, weaponSettings.reloadTime, weaponSettings.maxRound);
+
+	dispersionState = weaponSettings.dispersionWeapon.GetDispersionState(dispersionMovementState);
+	dispersion = dispersionState.start;
+	dispersionTime = GetWorld()->GetTimeSeconds();
+	shotCounter = 0;
+
+	// Spawn projectiles for this weapon now, not on the first shot
+	const FProjectileInfo& projectileSettings = GetProjectile();
+	UProjectilePoolSubsystem* myPool = GetWorld()->GetSubsystem<UProjectilePoolSubsystem>();
+	if (myPool && projectileSettings.projectile && !projectileSettings.bIsSimulated)
+		myPool->PrewarmPool(projectileSettings.projectile, myPool->prewarmCount);
+}
+
+const FWeaponInfo& AWeaponActor_Base::GetWeaponSettings() const
+{
+	static const FWeaponInfo defaultWeaponSettings;
+	const FWeaponInfo* myWeaponInfo = weaponRegistry ? weaponRegistry->GetWeaponInfo(weaponHandle) : nullptr;
+	return myWeaponInfo ? *myWeaponInfo : defaultWeaponSettings;
+}
 
 int32 AWeaponActor_Base::GetWeaponRound()
 { return weaponInfo.round; }
+
+void AWeaponActor_Base::SetWeaponRound(int32 newRound)
+{
+	weaponInfo.round = FMath::Max(newRound, 0);
+
+	UWeaponTickSubsystem* myTick = GetTickSubsystem();
+	if (myTick)
+		myTick->SetWeaponRound(tickSlot, weaponInfo.round);
+}
+
+bool AWeaponActor_Base::IsWeaponFiring() const
+{
+	UWeaponTickSubsystem* myTick = GetTickSubsystem();
+	return myTick && myTick->IsTriggerHeld(tickSlot);
+}
+
+bool AWeaponActor_Base::IsWeaponReloading() const
+{ return GetWeaponState() == EWeaponState::RELOADING_STATE; }
+
+EWeaponState AWeaponActor_Base::GetWeaponState() const
+{
+	UWeaponTickSubsystem* myTick = GetTickSubsystem();
+	return myTick ? myTick->GetWeaponState(tickSlot) : EWeaponState::IDLE_STATE;
+}
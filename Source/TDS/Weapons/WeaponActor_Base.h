@@ -12,6 +12,8 @@
 #include "Projectiles/Projectile_Base.h"
 #include "WeaponActor_Base.generated.h"
 
+enum class ESignificanceTier : uint8;
+
 //DECLARE_DYNAMIC_MULTICAST_DELEGATE(FOnWeaponFireStart);//ToDo Delegate on event weapon fire - Anim char, state char...
 
 UCLASS()
@@ -31,54 +33,109 @@ public:
 	class UStaticMeshComponent* staticMeshWeapon = nullptr;
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"), Category = Components)
 	class UArrowComponent* shootLocation = nullptr;
+	// Shell casings are thrown along its forward vector
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"), Category = Components)
+	class UArrowComponent* sleeveLocation = nullptr;
 
-	UPROPERTY()
-	FWeaponInfo weaponSettings;
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Weapon info")
+	UPROPERTY(BlueprintReadOnly, Category = "Weapon info")
+	FWeaponHandle weaponHandle;
+	// Mirror of the state in UWeaponTickSubsystem, written back when the weapon fires or reloads. Change it with SetWeaponRound
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Weapon info")
 	FAddicionalWeaponInfo weaponInfo;
 
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 public:
-	// Tick func
-	virtual void Tick(float DeltaTime) override;
-
-	void FireTick(float DeltaTime);
-	void ReloadTick(float DeltaTime);
-
 	void WeaponInit();
 	void InitReload();
 
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "FireLogic")
-	bool weaponFiring = false;
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "FireLogic")
-	bool weaponReloading = false;
-
 	UFUNCTION(BlueprintCallable)
 	void SetWeaponStateFire(bool bIsFire);
 
 	bool CheckWeaponCanFire();
 
-	FProjectileInfo GetProjectile();
+	const FProjectileInfo& GetProjectile() const;
 
-	void Fire();
+	// All shots of one tick, oldest first
+	void FireBatch(const TArray<FWeaponShot>& shots);
 
 	void UpdateStateWeapon(EMovementState NewMovementState);
 	void ChangeDispersion();
 
-	//Timers'flags
-	float fireTimer = 0.f;
-	float reloadTimer = 0.f;
+	// The same seed gives the same spread pattern on every machine (server, clients, replay)
+	UFUNCTION(BlueprintCallable)
+	void SetDispersionSeed(int32 newSeed);
+	// Cone half angle in degrees
+	UFUNCTION(BlueprintCallable)
+	float GetCurrentDispersion() const;
+
+	// ============================ UWeaponTickSubsystem ============================
+	// Shots which were due during the last tick, the first one firstShotOffset seconds ago
+	void OnWeaponFired(int32 numShots, float firstShotOffset, float fireInterval, int32 newRound);
+	void OnReloadStarted();
+	void OnReloadFinished(int32 newRound);
+	void SetTickSlot(int32 newTickSlot);
+
+	// ================================= Network =================================
+	// Shots fired by the server copy of the weapon, rebuilt here for projectiles and FX only
+	void ReplayShotBatch(const FWeaponShotBatch& shotBatch);
 
 private:
-	void FinishReload();
+	class UWeaponTickSubsystem* GetTickSubsystem() const;
+
+	// Spread of the shot fired at shotTime, grows the dispersion by the shot coefficient
+	FVector GetShotDirection(const FVector& forward, const FVector& right, const FVector& up, float shotTime);
+	float GetDispersionAt(float time) const;
+
+	// Projectiles, FX and casings of the batch, latency moves every shot further along its flight
+	void PlayShotBatch(const FWeaponShotBatch& shotBatch, float fireInterval, float latency);
+	float GetServerWorldTime() const;
+
+	// Debris lands where the instigator stands
+	float GetGroundZ() const;
+	// Far and off-screen weapons spawn less FX and debris
+	ESignificanceTier GetSignificanceTier() const;
+
+	// ================================ Dispersion ================================
+	EMovementState dispersionMovementState = EMovementState::RUN_STATE;
+	FDispersionState dispersionState;
+	// Weapon does not tick, the spread recovers from the value and the time of its last change
+	float dispersion = 0.f;
+	float dispersionTime = 0.f;
+	int32 dispersionSeed = 0;
+	uint32 shotCounter = 0;
+
+	// Fire and reload timers live in UWeaponTickSubsystem, the weapon does not tick
+	int32 tickSlot = INDEX_NONE;
+
+	// Definition and cone samples are looked up by weaponHandle on every use,
+	// the registry rebuilds its arrays when the weapon table is reimported
+	UPROPERTY()
+	class UWeaponRegistrySubsystem* weaponRegistry = nullptr;
+
+	// Reused every tick to collect the shots
+	TArray<FWeaponShot> pendingShots;
 
 public:
 	// ================================= Setters and Getters =================================
-	void SetWeaponSettings(FWeaponInfo newWeaponSettings);
+	void SetWeaponDefinition(FWeaponHandle newWeaponHandle);
+	// Default settings if the weapon has no definition
+	const FWeaponInfo& GetWeaponSettings() const;
 
 	UFUNCTION(BlueprintCallable)
 	int32 GetWeaponRound();
+	// E.g. ammo picked up, goes to the weapon tick subsystem as well
+	UFUNCTION(BlueprintCallable)
+	void SetWeaponRound(int32 newRound);
+
+	// Trigger is held
+	UFUNCTION(BlueprintCallable)
+	bool IsWeaponFiring() const;
+	UFUNCTION(BlueprintCallable)
+	bool IsWeaponReloading() const;
+	UFUNCTION(BlueprintCallable)
+	EWeaponState GetWeaponState() const;
 };
@@ -0,0 +1,204 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WeaponDebrisSubsystem.h"
+#include "Engine/World.h"
+#include "Engine/StaticMesh.h"
+#include "Components/InstancedStaticMeshComponent.h"
+
+#include "../TDSStats.h"
+
+bool UWeaponDebrisSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{ return Super::ShouldCreateSubsystem(Outer) && !IsRunningDedicatedServer(); }
+
+void UWeaponDebrisSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	const int32* mapDebrisCap = mapDebrisCaps.Find(GetWorld()->RemovePIEPrefix(GetWorld()->GetMapName()));
+	debrisCap = FMath::Max(mapDebrisCap ? *mapDebrisCap : defaultDebrisCap, 0);
+}
+
+void UWeaponDebrisSubsystem::Deinitialize()
+{
+	debrisRings.Empty();
+	ringIndexByMesh.Empty();
+	meshComponents.Empty();
+	batchTransforms.Empty();
+	renderActor = nullptr;
+
+	Super::Deinitialize();
+}
+
+TStatId UWeaponDebrisSubsystem::GetStatId() const
+{ RETURN_QUICK_DECLARE_CYCLE_STAT(UWeaponDebrisSubsystem, STATGROUP_Tickables); }
+
+void UWeaponDebrisSubsystem::Tick(float DeltaTime)
+{
+	TDS_SCOPE_CYCLE_COUNTER(WeaponDebris);
+
+	const float currentTime = GetWorld()->GetTimeSeconds();
+	const float fadeStartAge = debrisLifeTime - debrisFadeTime;
+
+	for (FDebrisRing& ring : debrisRings)
+	{
+		UInstancedStaticMeshComponent* meshComponent = meshComponents[ring.meshComponentIndex];
+		int32 firstDirty = INDEX_NONE;
+		int32 lastDirty = INDEX_NONE;
+
+		// Resting pieces are not touched until they start to fade
+		for (int32 slot = 0; slot < ring.states.Num(); ++slot)
+		{
+			EDebrisState& state = ring.states[slot];
+			if (state == EDebrisState::HIDDEN_STATE)
+				continue;
+
+			const float age = currentTime - ring.spawnTimes[slot];
+
+			if (age >= debrisLifeTime)
+				state = EDebrisState::HIDDEN_STATE;
+			else if (age >= fadeStartAge)
+				state = EDebrisState::FADING_STATE;
+			else if (state == EDebrisState::FLYING_STATE && currentTime >= ring.landTimes[slot])
+				state = EDebrisState::RESTING_STATE;
+			else if (state == EDebrisState::RESTING_STATE)
+				continue;
+
+			if (firstDirty == INDEX_NONE)
+				firstDirty = slot;
+			lastDirty = slot;
+		}
+
+		if (firstDirty == INDEX_NONE)
+			continue;
+
+		// Resting pieces in the range get the transform they already have
+		batchTransforms.Reset();
+		for (int32 slot = firstDirty; slot <= lastDirty; ++slot)
+			batchTransforms.Add(GetDebrisTransform(ring, slot, currentTime));
+
+		meshComponent->BatchUpdateInstancesTransforms(firstDirty, batchTransforms, true, true, true);
+	}
+}
+
+void UWeaponDebrisSubsystem::SpawnDebris(UStaticMesh* mesh, const FVector& location, const FRotator& rotation, const FVector& velocity, float groundZ)
+{
+	if (!mesh || debrisCap <= 0)
+		return;
+
+	const int32 ringIndex = FindOrAddRing(mesh);
+	if (ringIndex == INDEX_NONE)
+		return;
+
+	FDebrisRing& ring = debrisRings[ringIndex];
+	UInstancedStaticMeshComponent* meshComponent = meshComponents[ring.meshComponentIndex];
+
+	int32 slot = ring.nextSlot;
+	if (slot >= ring.states.Num())
+	{
+		ring.startLocations.AddDefaulted();
+		ring.startVelocities.AddDefaulted();
+		ring.startRotations.AddDefaulted();
+		ring.spins.AddDefaulted();
+		ring.spawnTimes.AddDefaulted();
+		ring.landTimes.AddDefaulted();
+		ring.states.AddDefaulted();
+		slot = meshComponent->AddInstanceWorldSpace(FTransform(rotation, location));
+	}
+	ring.nextSlot = (slot + 1) % debrisCap;
+
+	const float currentTime = GetWorld()->GetTimeSeconds();
+
+	// Time the arc reaches the ground: groundZ = z + vz * t + gravityZ * t^2 / 2
+	const float height = FMath::Max(location.Z - groundZ, 0.f);
+	const float fall = -gravityZ;
+	const float flightTime = fall > KINDA_SMALL_NUMBER
+		? (velocity.Z + FMath::Sqrt(FMath::Square(velocity.Z) + 2.f * fall * height)) / fall
+		: 0.f;
+
+	ring.startLocations[slot] = location;
+	ring.startVelocities[slot] = velocity;
+	ring.startRotations[slot] = rotation;
+	ring.spins[slot] = FRotator(FMath::FRandRange(-720.f, 720.f), FMath::FRandRange(-720.f, 720.f), FMath::FRandRange(-720.f, 720.f));
+	ring.spawnTimes[slot] = currentTime;
+	ring.landTimes[slot] = currentTime + flightTime;
+	ring.states[slot] = EDebrisState::FLYING_STATE;
+
+	// Flying, the next tick sends it with the others
+	meshComponent->UpdateInstanceTransform(slot, GetDebrisTransform(ring, slot, currentTime), true, false, true);
+}
+
+int32 UWeaponDebrisSubsystem::GetNumDebris() const
+{
+	int32 numDebris = 0;
+
+	for (const FDebrisRing& ring : debrisRings)
+		for (const EDebrisState state : ring.states)
+			numDebris += state != EDebrisState::HIDDEN_STATE ? 1 : 0;
+
+	return numDebris;
+}
+
+int32 UWeaponDebrisSubsystem::FindOrAddRing(UStaticMesh* mesh)
+{
+	if (const int32* ringIndex = ringIndexByMesh.Find(mesh))
+		return *ringIndex;
+
+	UWorld* world = GetWorld();
+	gravityZ = world->GetGravityZ();
+
+	if (!renderActor)
+	{
+		FActorSpawnParameters spawnParams;
+		spawnParams.ObjectFlags |= RF_Transient;
+		renderActor = world->SpawnActor<AActor>(AActor::StaticClass(), FTransform::Identity, spawnParams);
+	}
+
+	if (!renderActor)
+		return INDEX_NONE;
+
+	UInstancedStaticMeshComponent* newMeshComponent = NewObject<UInstancedStaticMeshComponent>(renderActor);
+	newMeshComponent->SetStaticMesh(mesh);
+	newMeshComponent->SetMobility(EComponentMobility::Movable);
+	newMeshComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	newMeshComponent->SetCanEverAffectNavigation(false);
+	newMeshComponent->SetCastShadow(false);
+
+	if (renderActor->GetRootComponent())
+		newMeshComponent->SetupAttachment(renderActor->GetRootComponent());
+	else
+		renderActor->SetRootComponent(newMeshComponent);
+
+	newMeshComponent->RegisterComponent();
+
+	FDebrisRing newRing;
+	newRing.meshComponentIndex = meshComponents.Add(newMeshComponent);
+
+	const int32 newRingIndex = debrisRings.Add(newRing);
+	ringIndexByMesh.Add(mesh, newRingIndex);
+
+	return newRingIndex;
+}
+
+FTransform UWeaponDebrisSubsystem::GetDebrisTransform(const FDebrisRing& ring, int32 slot, float currentTime) const
+{
+	if (ring.states[slot] == EDebrisState::HIDDEN_STATE)
+		return FTransform(FQuat::Identity, ring.startLocations[slot], FVector::ZeroVector);
+
+	const float flightTime = FMath::Min(currentTime, ring.landTimes[slot]) - ring.spawnTimes[slot];
+
+	const FVector& velocity = ring.startVelocities[slot];
+	FVector location = ring.startLocations[slot] + velocity * flightTime;
+	location.Z += 0.5f * gravityZ * FMath::Square(flightTime);
+
+	// Flying piece tumbles, a landed one lies flat with the yaw it had
+	FRotator rotation = ring.startRotations[slot] + ring.spins[slot] * flightTime;
+	if (ring.states[slot] != EDebrisState::FLYING_STATE)
+		rotation = FRotator(0.f, rotation.Yaw, 0.f);
+
+	float scale = 1.f;
+	if (ring.states[slot] == EDebrisState::FADING_STATE && debrisFadeTime > 0.f)
+		scale = FMath::Clamp((debrisLifeTime - (currentTime - ring.spawnTimes[slot])) / debrisFadeTime, 0.f, 1.f);
+
+	return FTransform(rotation, location, FVector(scale));
+}
@@ -0,0 +1,89 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "../Game/TDSTickableWorldSubsystem.h"
+#include "WeaponDebrisSubsystem.generated.h"
+
+class UStaticMesh;
+class UInstancedStaticMeshComponent;
+
+enum class EDebrisState : uint8
+{
+	FLYING_STATE,
+	RESTING_STATE,
+	FADING_STATE,
+	HIDDEN_STATE
+};
+
+// Debris of one mesh, slot i is instance i of the mesh component. New debris take the oldest slot once the ring is full
+struct FDebrisRing
+{
+	int32 meshComponentIndex = INDEX_NONE;
+	int32 nextSlot = 0;
+
+	TArray<FVector> startLocations;
+	TArray<FVector> startVelocities;
+	TArray<FRotator> startRotations;
+	// Degrees per second while flying
+	TArray<FRotator> spins;
+	TArray<float> spawnTimes;
+	TArray<float> landTimes;
+	TArray<EDebrisState> states;
+};
+
+// Shell casings and dropped magazines without actors or physics: each piece flies on an analytic arc,
+// lies where it lands and shrinks away at the end of its life. All pieces of a mesh are one instanced component.
+// A plain one, not hierarchical: some piece moves almost every frame and a HISM would rebuild its tree for it
+UCLASS(Config = Game)
+class TDS_API UWeaponDebrisSubsystem : public UTDSTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// Nothing to look at on a dedicated server
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// Pieces of one mesh kept in the map at once
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "Debris")
+	int32 defaultDebrisCap = 256;
+	// Cap by map name, for maps with long firefights
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "Debris")
+	TMap<FString, int32> mapDebrisCaps;
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "Debris")
+	float debrisLifeTime = 20.f;
+	// Last part of the life time in which the piece shrinks away
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "Debris")
+	float debrisFadeTime = 2.f;
+
+	// Piece falls from location with the velocity until it reaches groundZ
+	void SpawnDebris(UStaticMesh* mesh, const FVector& location, const FRotator& rotation, const FVector& velocity, float groundZ);
+
+	UFUNCTION(BlueprintCallable)
+	int32 GetNumDebris() const;
+
+private:
+	int32 FindOrAddRing(UStaticMesh* mesh);
+	FTransform GetDebrisTransform(const FDebrisRing& ring, int32 slot, float currentTime) const;
+
+	int32 debrisCap = 256;
+	float gravityZ = 0.f;
+
+	TArray<FDebrisRing> debrisRings;
+	TMap<UStaticMesh*, int32> ringIndexByMesh;
+
+	// ================================ Render ===============================
+	UPROPERTY()
+	AActor* renderActor = nullptr;
+	UPROPERTY()
+	TArray<UInstancedStaticMeshComponent*> meshComponents;
+	// Slots from the first to the last changed one, sent in one batch per mesh
+	TArray<FTransform> batchTransforms;
+};
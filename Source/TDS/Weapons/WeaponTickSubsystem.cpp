@@ -0,0 +1,164 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WeaponTickSubsystem.h"
+
+#include "WeaponActor_Base.h"
+
+#include "../TDSStats.h"
+
+static_assert(static_cast<uint8>(EWeaponState::IDLE_STATE) == static_cast<uint8>(EWeaponSimState::IDLE_STATE)
+	&& static_cast<uint8>(EWeaponState::FIRING_STATE) == static_cast<uint8>(EWeaponSimState::FIRING_STATE)
+	&& static_cast<uint8>(EWeaponState::COOLDOWN_STATE) == static_cast<uint8>(EWeaponSimState::COOLDOWN_STATE)
+	&& static_cast<uint8>(EWeaponState::RELOADING_STATE) == static_cast<uint8>(EWeaponSimState::RELOADING_STATE),
+	"EWeaponSimState must follow EWeaponState");
+
+void UWeaponTickSubsystem::Deinitialize()
+{
+	weaponStates.Empty();
+	weaponConfigs.Empty();
+	weapons.Empty();
+	tickEvents.Empty();
+	dispatchedEvents.Empty();
+
+	Super::Deinitialize();
+}
+
+TStatId UWeaponTickSubsystem::GetStatId() const
+{ RETURN_QUICK_DECLARE_CYCLE_STAT(UWeaponTickSubsystem, STATGROUP_Tickables); }
+
+void UWeaponTickSubsystem::Tick(float DeltaTime)
+{
+	TDS_SCOPE_CYCLE_COUNTER(WeaponTick);
+
+	int32 timersRunning = 0;
+
+	for (int32 slot = 0; slot < weaponStates.Num(); ++slot)
+	{
+		FWeaponSimState& weaponState = weaponStates[slot];
+		if (weaponState.state == EWeaponSimState::IDLE_STATE)
+			continue;
+
+		timersRunning++;
+
+		const FWeaponSimStep step = TDSSimulation::StepWeapon(weaponState, weaponConfigs[slot], DeltaTime);
+
+		if (step.numShots > 0)
+		{
+			FWeaponTickEvent& fireEvent = tickEvents.AddDefaulted_GetRef();
+			fireEvent.weapon = weapons[slot];
+			fireEvent.type = EWeaponTickEventType::FIRED;
+			fireEvent.numShots = step.numShots;
+			fireEvent.firstShotOffset = step.firstShotOffset;
+			fireEvent.fireInterval = weaponConfigs[slot].fireInterval;
+			fireEvent.round = weaponState.round;
+		}
+
+		if (step.bIsReloadStarted)
+			AddReloadEvent(slot, EWeaponTickEventType::RELOAD_STARTED);
+		if (step.bIsReloadFinished)
+			AddReloadEvent(slot, EWeaponTickEventType::RELOAD_FINISHED);
+	}
+
+	TDS_SET_COUNTER(TimersRunning, timersRunning);
+
+	// Events raised from the callbacks go out on the next tick
+	Swap(tickEvents, dispatchedEvents);
+	tickEvents.Reset();
+
+	for (const FWeaponTickEvent& tickEvent : dispatchedEvents)
+	{
+		AWeaponActor_Base* myWeapon = tickEvent.weapon.Get();
+		if (!IsValid(myWeapon))
+			continue;
+
+		switch (tickEvent.type)
+		{
+		case EWeaponTickEventType::FIRED:
+			myWeapon->OnWeaponFired(tickEvent.numShots, tickEvent.firstShotOffset, tickEvent.fireInterval, tickEvent.round);
+			break;
+		case EWeaponTickEventType::RELOAD_STARTED:
+			myWeapon->OnReloadStarted();
+			break;
+		case EWeaponTickEventType::RELOAD_FINISHED:
+			myWeapon->OnReloadFinished(tickEvent.round);
+			break;
+		}
+	}
+}
+
+int32 UWeaponTickSubsystem::RegisterWeapon(AWeaponActor_Base* weapon, int32 initialRound)
+{
+	FWeaponSimState& newState = weaponStates.AddDefaulted_GetRef();
+	newState.round = initialRound;
+
+	FWeaponSimConfig& newConfig = weaponConfigs.AddDefaulted_GetRef();
+	newConfig.maxRound = initialRound;
+
+	return weapons.Add(weapon);
+}
+
+void UWeaponTickSubsystem::UnregisterWeapon(int32 slot)
+{
+	if (!weapons.IsValidIndex(slot))
+		return;
+
+	weaponStates.RemoveAtSwap(slot, 1, false);
+	weaponConfigs.RemoveAtSwap(slot, 1, false);
+	weapons.RemoveAtSwap(slot, 1, false);
+
+	// The last weapon took the freed slot
+	if (weapons.IsValidIndex(slot) && IsValid(weapons[slot]))
+		weapons[slot]->SetTickSlot(slot);
+}
+
+void UWeaponTickSubsystem::SetWeaponConfig(int32 slot, float fireInterval, float reloadTime, int32 maxRound)
+{
+	if (!weapons.IsValidIndex(slot))
+		return;
+
+	FWeaponSimConfig& weaponConfig = weaponConfigs[slot];
+	weaponConfig.fireInterval = FMath::Max(fireInterval, KINDA_SMALL_NUMBER);
+	weaponConfig.reloadTime = reloadTime;
+	weaponConfig.maxRound = maxRound;
+}
+
+// ================================= Transitions =================================
+void UWeaponTickSubsystem::SetTriggerHeld(int32 slot, bool bIsTriggerHeld)
+{
+	if (weapons.IsValidIndex(slot))
+		TDSSimulation::SetTriggerHeld(weaponStates[slot], bIsTriggerHeld);
+}
+
+void UWeaponTickSubsystem::StartReload(int32 slot)
+{
+	if (weapons.IsValidIndex(slot) && TDSSimulation::StartReload(weaponStates[slot], weaponConfigs[slot]))
+		AddReloadEvent(slot, EWeaponTickEventType::RELOAD_STARTED);
+}
+
+void UWeaponTickSubsystem::SetWeaponRound(int32 slot, int32 newRound)
+{
+	if (weapons.IsValidIndex(slot))
+		weaponStates[slot].round = FMath::Max(newRound, 0);
+}
+
+void UWeaponTickSubsystem::AddReloadEvent(int32 slot, EWeaponTickEventType eventType)
+{
+	FWeaponTickEvent& reloadEvent = tickEvents.AddDefaulted_GetRef();
+	reloadEvent.weapon = weapons[slot];
+	reloadEvent.type = eventType;
+	reloadEvent.round = weaponStates[slot].round;
+}
+
+// ================================= Getters =================================
+EWeaponState UWeaponTickSubsystem::GetWeaponState(int32 slot) const
+{ return weaponStates.IsValidIndex(slot) ? static_cast<EWeaponState>(weaponStates[slot].state) : EWeaponState::IDLE_STATE; }
+
+bool UWeaponTickSubsystem::IsTriggerHeld(int32 slot) const
+{ return weaponStates.IsValidIndex(slot) && weaponStates[slot].bIsTriggerHeld; }
+
+int32 UWeaponTickSubsystem::GetWeaponRound(int32 slot) const
+{ return weaponStates.IsValidIndex(slot) ? weaponStates[slot].round : 0; }
+
+int32 UWeaponTickSubsystem::GetNumWeapons() const
+{ return weapons.Num(); }
@@ -0,0 +1,76 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "../FuncLibrary/Types.h"
+#include "../Game/TDSTickableWorldSubsystem.h"
+#include "../Simulation/WeaponSimulation.h"
+#include "WeaponTickSubsystem.generated.h"
+
+class AWeaponActor_Base;
+
+// Fire and reload timers of all weapons of the world in flat arrays, advanced in one loop per frame.
+// Weapons are called back only when they fire or finish reloading
+UCLASS()
+class TDS_API UWeaponTickSubsystem : public UTDSTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// Returns the slot of the weapon. Unregister moves the last weapon into the freed slot (AWeaponActor_Base::SetTickSlot)
+	int32 RegisterWeapon(AWeaponActor_Base* weapon, int32 initialRound);
+	void UnregisterWeapon(int32 slot);
+	void SetWeaponConfig(int32 slot, float fireInterval, float reloadTime, int32 maxRound);
+
+	// ================================= Transitions =================================
+	void SetTriggerHeld(int32 slot, bool bIsTriggerHeld);
+	void StartReload(int32 slot);
+	void SetWeaponRound(int32 slot, int32 newRound);
+
+	// ================================= Getters =================================
+	EWeaponState GetWeaponState(int32 slot) const;
+	bool IsTriggerHeld(int32 slot) const;
+	int32 GetWeaponRound(int32 slot) const;
+
+	UFUNCTION(BlueprintCallable)
+	int32 GetNumWeapons() const;
+
+private:
+	// Rules of one weapon are in TDSSimulation::StepWeapon, the arrays only hold the state of all weapons
+	TArray<FWeaponSimState> weaponStates;
+	TArray<FWeaponSimConfig> weaponConfigs;
+
+	UPROPERTY()
+	TArray<AWeaponActor_Base*> weapons;
+
+	enum class EWeaponTickEventType : uint8
+	{
+		FIRED,
+		RELOAD_STARTED,
+		RELOAD_FINISHED
+	};
+
+	struct FWeaponTickEvent
+	{
+		// Events wait for the next tick, the weapon may be collected by then
+		TWeakObjectPtr<AWeaponActor_Base> weapon;
+		EWeaponTickEventType type = EWeaponTickEventType::FIRED;
+		int32 numShots = 0;
+		float firstShotOffset = 0.f;
+		float fireInterval = 0.f;
+		int32 round = 0;
+	};
+
+	void AddReloadEvent(int32 slot, EWeaponTickEventType eventType);
+
+	// Callbacks are made after the loop, a weapon may change the arrays from its callback
+	TArray<FWeaponTickEvent> tickEvents;
+	TArray<FWeaponTickEvent> dispatchedEvents;
+};
@@ -0,0 +1,155 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WeaponTraceSubsystem.h"
+#include "Engine/World.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/Controller.h"
+#include "GameFramework/DamageType.h"
+#include "Kismet/GameplayStatics.h"
+#include "HAL/IConsoleManager.h"
+
+#include "FXPoolSubsystem.h"
+#include "LagCompensationSubsystem.h"
+#include "DamageSubsystem.h"
+#include "../TDSStats.h"
+
+static TAutoConsoleVariable<bool> CVarWeaponSyncTraceFire(
+	TEXT("tds.Weapon.SyncTraceFire"),
+	false,
+	TEXT("Trace weapons use synchronous line traces instead of async ones (for comparison)."));
+
+bool UWeaponTraceSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	UWorld* world = Cast<UWorld>(Outer);
+	return world && world->IsGameWorld();
+}
+
+void UWeaponTraceSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	traceDelegate.BindUObject(this, &UWeaponTraceSubsystem::OnTraceCompleted);
+}
+
+void UWeaponTraceSubsystem::Deinitialize()
+{
+	traceDelegate.Unbind();
+	pendingShots.Empty();
+
+	Super::Deinitialize();
+}
+
+void UWeaponTraceSubsystem::QueueTraceShot(const FWeaponInfo& weaponInfo, const FVector& start, const FVector& direction, AActor* damageCauser, APawn* newInstigator, float rewindTime)
+{
+	UWorld* world = GetWorld();
+	if (!world)
+		return;
+
+	FWeaponTraceShot newShot;
+	newShot.damageCauser = damageCauser;
+	newShot.instigator = newInstigator;
+	newShot.direction = direction.GetSafeNormal();
+	newShot.damage = weaponInfo.weaponDamage;
+	newShot.decalOnHit = weaponInfo.decalOnHit.Get();
+	newShot.decalOnHitSize = weaponInfo.decalOnHitSize;
+	newShot.decalOnHitLifeTime = weaponInfo.decalOnHitLifeTime;
+	newShot.effectOnHit = weaponInfo.effectOnHit.Get();
+
+	newShot.start = start;
+	newShot.end = start + newShot.direction * weaponInfo.distanceTrace;
+
+	FCollisionQueryParams queryParams(SCENE_QUERY_STAT(WeaponTraceShot), false);
+	queryParams.bReturnPhysicalMaterial = true;
+	queryParams.AddIgnoredActor(damageCauser);
+	queryParams.AddIgnoredActor(newInstigator);
+
+	// Compensated characters are not traced where they are now, only in the past
+	const ULagCompensationSubsystem* myLagCompensation = world->GetSubsystem<ULagCompensationSubsystem>();
+	if (rewindTime >= 0.f && myLagCompensation && myLagCompensation->IsActive())
+	{
+		newShot.rewindTime = rewindTime;
+		myLagCompensation->AddIgnoredTargets(queryParams);
+	}
+
+	const FVector& end = newShot.end;
+
+	if (CVarWeaponSyncTraceFire.GetValueOnGameThread())
+	{
+		TDS_INC_COUNTER(TracesIssued, 1);
+
+		FHitResult hitResult;
+		const bool bIsHit = world->LineTraceSingleByChannel(hitResult, start, end, traceChannel, queryParams);
+		ResolveTraceShot(newShot, bIsHit ? &hitResult : nullptr);
+		return;
+	}
+
+	TDS_INC_COUNTER(TracesIssued, 1);
+
+	const uint32 shotId = nextShotId++;
+	pendingShots.Add(shotId, newShot);
+	world->AsyncLineTraceByChannel(EAsyncTraceType::Single, start, end, traceChannel, queryParams, FCollisionResponseParams::DefaultResponseParam, &traceDelegate, shotId);
+}
+
+void UWeaponTraceSubsystem::QueueTraceShots(const FWeaponInfo& weaponInfo, const TArray<FWeaponShot>& shots, AActor* damageCauser, APawn* newInstigator, float viewTime)
+{
+	for (const FWeaponShot& shot : shots)
+		QueueTraceShot(weaponInfo, shot.location, shot.direction, damageCauser, newInstigator, viewTime >= 0.f ? viewTime - shot.timeOffset : -1.f);
+}
+
+int32 UWeaponTraceSubsystem::GetNumPendingShots() const
+{ return pendingShots.Num(); }
+
+void UWeaponTraceSubsystem::OnTraceCompleted(const FTraceHandle& traceHandle, FTraceDatum& traceDatum)
+{
+	FWeaponTraceShot shot;
+	if (!pendingShots.RemoveAndCopyValue(traceDatum.UserData, shot))
+		return;
+
+	const FHitResult* levelHit = traceDatum.OutHits.FindByPredicate([](const FHitResult& hitResult) { return hitResult.bBlockingHit; });
+	ResolveTraceShot(shot, levelHit);
+}
+
+void UWeaponTraceSubsystem::ResolveTraceShot(const FWeaponTraceShot& shot, const FHitResult* levelHit)
+{
+	const ULagCompensationSubsystem* myLagCompensation = GetWorld()->GetSubsystem<ULagCompensationSubsystem>();
+	if (shot.rewindTime >= 0.f && myLagCompensation)
+	{
+		FHitResult rewoundHit;
+		const FVector rewoundEnd = levelHit ? levelHit->ImpactPoint : shot.end;
+		if (myLagCompensation->TraceRewound(rewoundHit, shot.start, rewoundEnd, shot.rewindTime, shot.instigator.Get()))
+		{
+			ApplyTraceShot(shot, rewoundHit);
+			return;
+		}
+	}
+
+	if (levelHit)
+		ApplyTraceShot(shot, *levelHit);
+}
+
+void UWeaponTraceSubsystem::ApplyTraceShot(const FWeaponTraceShot& shot, const FHitResult& hitResult)
+{
+	TDS_SCOPE_CYCLE_COUNTER(TraceHit);
+
+	UFXPoolSubsystem* myFXPool = GetWorld()->GetSubsystem<UFXPoolSubsystem>();
+	const FRotator hitRotation = (-hitResult.ImpactNormal).Rotation();
+
+	if (myFXPool && shot.decalOnHit)
+		myFXPool->SpawnDecal(shot.decalOnHit, shot.decalOnHitSize, hitResult.ImpactPoint, hitRotation, shot.decalOnHitLifeTime, hitResult.GetComponent());
+
+	if (myFXPool && shot.effectOnHit)
+		myFXPool->SpawnEmitter(shot.effectOnHit, hitResult.ImpactPoint, hitResult.ImpactNormal.Rotation());
+
+	// Clients replay shots of the server for the FX only
+	AActor* hitActor = hitResult.GetActor();
+	if (hitActor && shot.damage > 0.f && GetWorld()->GetNetMode() != NM_Client)
+	{
+		APawn* myInstigator = shot.instigator.Get();
+		AController* instigatorController = myInstigator ? myInstigator->GetController() : nullptr;
+		UDamageSubsystem* myDamage = GetWorld()->GetSubsystem<UDamageSubsystem>();
+
+		if (!myDamage || !myDamage->QueueDamage(hitActor, shot.damage, hitResult.BoneName, instigatorController))
+			UGameplayStatics::ApplyPointDamage(hitActor, shot.damage, shot.direction, hitResult, instigatorController, shot.damageCauser.Get(), UDamageType::StaticClass());
+	}
+}
@@ -0,0 +1,61 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "WorldCollision.h"
+
+#include "../FuncLibrary/Types.h"
+#include "WeaponTraceSubsystem.generated.h"
+
+// What is needed to apply a trace shot once its result is known
+struct FWeaponTraceShot
+{
+	TWeakObjectPtr<AActor> damageCauser;
+	TWeakObjectPtr<APawn> instigator;
+	FVector start = FVector::ZeroVector;
+	FVector end = FVector::ZeroVector;
+	FVector direction = FVector::ForwardVector;
+	// Server time the shooter saw the targets at, negative if the shot is not lag compensated
+	float rewindTime = -1.f;
+	float damage = 0.f;
+	UMaterialInterface* decalOnHit = nullptr;
+	FVector decalOnHitSize = FVector::OneVector;
+	float decalOnHitLifeTime = 0.f;
+	UParticleSystem* effectOnHit = nullptr;
+};
+
+// Hitscan fire: traces are queued during the frame and applied when the async results come back next frame
+UCLASS(Config = Game)
+class TDS_API UWeaponTraceSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	// Pawn profile ignores Visibility, so shots use a channel blocked by both pawns and the level
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "Trace")
+	TEnumAsByte<ECollisionChannel> traceChannel = ECC_Camera;
+
+	// Characters are hit where they were at rewindTime (ULagCompensationSubsystem), negative means where they are now
+	void QueueTraceShot(const FWeaponInfo& weaponInfo, const FVector& start, const FVector& direction, AActor* damageCauser, APawn* newInstigator, float rewindTime = -1.f);
+	// Every shot is rewound by its own time offset from viewTime
+	void QueueTraceShots(const FWeaponInfo& weaponInfo, const TArray<FWeaponShot>& shots, AActor* damageCauser, APawn* newInstigator, float viewTime = -1.f);
+
+	UFUNCTION(BlueprintCallable)
+	int32 GetNumPendingShots() const;
+
+private:
+	void OnTraceCompleted(const FTraceHandle& traceHandle, FTraceDatum& traceDatum);
+	// Level hit (or none) of the shot, checked against the rewound characters in front of it
+	void ResolveTraceShot(const FWeaponTraceShot& shot, const FHitResult* levelHit);
+	void ApplyTraceShot(const FWeaponTraceShot& shot, const FHitResult& hitResult);
+
+	FTraceDelegate traceDelegate;
+	TMap<uint32, FWeaponTraceShot> pendingShots;
+	uint32 nextShotId = 1;
+};
@@ -2,6 +2,9 @@
 
 
 #include "WorldItem_Base.h"
+#include "Engine/World.h"
+
+#include "../Game/SignificanceSubsystem.h"
 
 // Sets default values
 AWorldItem_Base::AWorldItem_Base()
@@ -15,7 +18,10 @@ AWorldItem_Base::AWorldItem_Base()
 void AWorldItem_Base::BeginPlay()
 {
 	Super::BeginPlay();
-	
+
+	USignificanceSubsystem* mySignificance = GetWorld()->GetSubsystem<USignificanceSubsystem>();
+	if (mySignificance)
+		mySignificance->RegisterActor(this, ESignificanceCategory::WORLD_ITEM);
 }
 
 // Called every frame